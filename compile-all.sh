@@ -8,11 +8,16 @@ mkdir -p $EXES
 
 # test macros:
 ## to be activated?
-## STORE_BY_ROWS: or by column (default)?
+## STORE_BY_ROWS: GPU consumer analyses chunks by rows or by column (default)? CPU consumers choose their own layout
 ## FLOAT: or double (default)?
 ## NO_PREALLOCATE_BUFFER: or preallocate buffer (default)
 ## YIELD: or no yield processor if iteration stalls (default)?
 ## SLOW: or perform computation in a much smarter manner (default)?
+## MMAP: read input through mmap or through std::ifstream (default)?
+## LEGACY_CONVERSION: convert fields with math::convertions::ston or with std::from_chars and a fast path (default)?
+## ZLIB: accept gzip compressed input (link with -lz)?
+## ZSTD: accept zstd compressed input (link with -lzstd)?
+## HUGE_PAGES: align large chunks to 2MB and advise transparent huge pages?
 
 
 ######################################## row | col
@@ -0,0 +1,93 @@
+/**
+ *  Microbenchmark of the number parsing backends (see src/number_parsing.hh)
+ *
+ *  Build and run:
+ *      g++ -std=gnu++17 -O3 number-parsing.cc -o number-parsing && ./number-parsing [fields]
+ *
+ *  For each numeric type, fields are generated in the shape found in
+ *  real datasets (integers only, or fixed point decimals) and converted
+ *  by every backend, reporting the average time per field.
+ */
+
+#include "../src/number_parsing.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// fields stored one after the other in a single buffer,
+// as they are found in a mapped file
+struct dataset {
+    std::string buffer;
+    std::vector<std::pair<std::size_t, std::size_t>> fields;
+
+    void push(const char* field) {
+        const std::size_t begin = buffer.size();
+        buffer.append(field);
+        fields.emplace_back(begin, buffer.size());
+        buffer.push_back(',');
+    }
+};
+
+dataset integers(std::size_t n) {
+    std::default_random_engine generator;
+    std::uniform_int_distribution<int> distribution(-1000000, 1000000);
+    dataset ans;
+    for (std::size_t i{}; i != n; ++i) {
+        ans.push(std::to_string(distribution(generator)).c_str());
+    }
+    return ans;
+}
+
+dataset decimals(std::size_t n) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-1000, 1000);
+    dataset ans;
+    char field[64];
+    for (std::size_t i{}; i != n; ++i) {
+        std::snprintf(field, sizeof(field), "%.6f", distribution(generator));
+        ans.push(field);
+    }
+    return ans;
+}
+
+// ns per field taken by the given backend
+template <typename T, typename backend>
+double measure(const dataset& data) {
+    const char* base = data.buffer.data();
+    // avoid the conversion to be optimized out
+    volatile T sink{};
+    T sum{};
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [begin, end] : data.fields) {
+        sum += backend::template parse<T>(base + begin, base + end);
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    sink = sum;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / data.fields.size();
+}
+
+template <typename T>
+void benchmark(const char* type, const dataset& data, const char* shape) {
+    std::cout << type << ", " << shape << ":\n"
+              << "\tlegacy (ston)    " << measure<T, number_parsing::legacy>(data) << " ns/field\n"
+              << "\tfrom_chars       " << measure<T, number_parsing::from_chars>(data) << " ns/field\n"
+              << "\tfast             " << measure<T, number_parsing::fast>(data) << " ns/field\n";
+}
+
+int main(int argc, char* argv[]) {
+    const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    const auto ints = integers(n);
+    const auto decs = decimals(n);
+
+    benchmark<int>("int", ints, "integers");
+    benchmark<float>("float", ints, "integers");
+    benchmark<float>("float", decs, "decimals");
+    benchmark<double>("double", ints, "integers");
+    benchmark<double>("double", decs, "decimals");
+}
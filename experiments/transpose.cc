@@ -0,0 +1,55 @@
+/**
+ *  Microbenchmark of the transposition routines (see src/transpose.hh)
+ *
+ *  Build and run:
+ *      g++ -std=gnu++17 -O3 transpose.cc -o transpose && ./transpose [rows] [cols]
+ *
+ *  A chunk of rows x cols items stored by rows is transposed to the
+ *  column layout by every routine, reporting the bandwidth reached
+ *  (bytes read plus bytes written per second).
+ */
+
+#include "../src/transpose.hh"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GB/s reached by the given routine
+template <typename T>
+double measure(transpose::routine<T> routine, std::size_t rows, std::size_t cols) {
+    std::vector<T> a(rows*cols), b(rows*cols);
+    for (std::size_t i{}; i != a.size(); ++i) {
+        a[i] = T(i);
+    }
+    // repeat so that each measure moves about 4 GB
+    const std::size_t bytes = 2*a.size()*sizeof(T);
+    const std::size_t repetitions = std::max<std::size_t>(1, (std::size_t(4) << 30) / bytes);
+    routine(a.data(), cols, b.data(), rows, rows, cols);
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i{}; i != repetitions; ++i) {
+        routine(a.data(), cols, b.data(), rows, rows, cols);
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    if (b[rows] != a[1]) {
+        std::cerr << "Wrong transposition\n";
+    }
+    return bytes * repetitions / std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+template <typename T>
+void benchmark(const char* type, std::size_t rows, std::size_t cols) {
+    std::cout << type << ", " << rows << "x" << cols << ":\n"
+              << "\tnaive            " << measure<T>(transpose::naive<T>, rows, cols) << " GB/s\n"
+              << "\ttiled            " << measure<T>(transpose::scalar<T>, rows, cols) << " GB/s\n"
+              << "\tbest             " << measure<T>(transpose::best_routine<T>(), rows, cols) << " GB/s\n";
+}
+
+int main(int argc, char* argv[]) {
+    const std::size_t rows = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const std::size_t cols = argc > 2 ? std::stoul(argv[2]) : 300;
+
+    benchmark<double>("double", rows, cols);
+    benchmark<float>("float", rows, cols);
+}
@@ -0,0 +1,96 @@
+
+#ifndef ALIGNED_BUFFER
+#define ALIGNED_BUFFER
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#ifdef HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+/**
+ * @brief Buffers for the items of chunks: they start at a cache line
+ * boundary and their leading dimension (distance between adjacent
+ * rows or columns) is padded so that every row or column starts at a
+ * cache line boundary too. Vectorized kernels can then use aligned
+ * loads of whole cache lines.
+ */
+namespace aligned_buffer {
+
+    constexpr std::size_t CACHE_LINE = 64;
+    // size of the transparent huge pages of x86-64
+    constexpr std::size_t HUGE_PAGE = std::size_t(2) << 20;
+    // distance of addresses mapped on the same L1 set
+    constexpr std::size_t ALIASING = 4096;
+
+    // items of type T in a cache line, the
+    // granularity of the leading dimensions
+    template <typename T>
+    constexpr std::size_t lanes() {
+        return sizeof(T) < CACHE_LINE ? CACHE_LINE / sizeof(T) : 1;
+    }
+
+    // leading dimension of a table whose rows (or columns) hold n
+    // items: n rounded up to whole cache lines, plus one cache line
+    // when rows would be a multiple of 4K apart, so that the same
+    // item of adjacent rows does not compete for the same L1 set
+    template <typename T>
+    std::size_t leading_dimension(std::size_t n) {
+        constexpr std::size_t l = lanes<T>();
+        std::size_t ans = (n + l - 1) / l * l;
+        if (ans > l && ans*sizeof(T) % ALIASING == 0) {
+            ans += l;
+        }
+        return ans;
+    }
+
+    // is p at a cache line boundary?
+    inline bool aligned(const void* p) {
+        return reinterpret_cast<std::uintptr_t>(p) % CACHE_LINE == 0;
+    }
+
+    struct deleter {
+        void operator()(void* p) const {
+            std::free(p);
+        }
+    };
+
+    template <typename T>
+    using buffer = std::unique_ptr<T[], deleter>;
+
+    // size items set to zero, aligned to a cache line (or to a
+    // huge page when large enough and HUGE_PAGES is defined)
+    template <typename T>
+    buffer<T> allocate(std::size_t size) {
+        std::size_t alignment = CACHE_LINE;
+        std::size_t bytes = size*sizeof(T);
+#ifdef HUGE_PAGES
+#pragma message "Allocate large chunks on transparent huge pages..."
+        if (bytes >= HUGE_PAGE) {
+            alignment = HUGE_PAGE;
+        }
+#endif
+        // aligned_alloc wants a multiple of the alignment
+        bytes = (bytes + alignment - 1) / alignment * alignment;
+        void* p = std::aligned_alloc(alignment, bytes ? bytes : alignment);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+#ifdef HUGE_PAGES
+        if (alignment == HUGE_PAGE) {
+            // only a hint, ignored if THP are disabled
+            ::madvise(p, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        // padding is never written, kernels may read it
+        std::memset(p, 0, bytes);
+        return buffer<T>(static_cast<T*>(p));
+    }
+}
+
+
+#endif
@@ -5,7 +5,23 @@
 
 [[noreturn]] void help(const char * const exe) {
     std::cerr << "Usage:\n";
-    std::cerr << '\t' << exe << " [--worksers NUM, default $(nproc)-1] [--rows NUM] input-file";
+    std::cerr << '\t' << exe << " [--worksers NUM, default $(nproc)-1] [--rows NUM|auto|adaptive] [--fused] [--io-depth NUM] [--io-block BYTES] [--direct] [--columns LIST] [--against LIST] [--numa] [--wait spin|yield|park] [--spins NUM] [--pin] [--cpus LIST] [--smt avoid|pack] [--isolate-main] [--roles] [--stats] [--max-memory BYTES] [--split TILES] input-file\n";
+    std::cerr << '\t' << exe << " --convert [--columns LIST] input-file output-file (.npy or native binary)\n";
+    std::cerr << "\tLIST: column names, indexes or ranges (e.g. 3-7, 10-) separated by commas\n";
+    std::cerr << "\t--rows auto: fit chunks in the caches, adaptive: then adapt them to the time taken by each chunk\n";
+    std::cerr << "\t--io-depth, --io-block, --direct: reads in flight, their size and O_DIRECT for uncompressed CSV files, not with MMAP\n";
+    std::cerr << "\t--against: correlate each column selected by --columns only with the ones in its LIST\n";
+    std::cerr << "\t--numa: run workers on the NUMA nodes in turn, each node analysing first its own chunks\n";
+    std::cerr << "\t--wait: what idle workers do, park (default): spin, then yield, then sleep until some work is available\n";
+    std::cerr << "\t--spins: stalled iterations spent spinning before parking\n";
+    std::cerr << "\t--pin: pin each worker to a CPU, --cpus, --smt and --isolate-main imply it\n";
+    std::cerr << "\t--cpus: CPUs workers are pinned to, in the format of taskset (e.g. 0-3,8)\n";
+    std::cerr << "\t--smt avoid: a worker per physical core while possible (default), pack: fill the cores one by one\n";
+    std::cerr << "\t--isolate-main: the main thread, reading the input, has a core on its own\n";
+    std::cerr << "\t--roles: workers either parse or analyse, moved between the two pools as needed, the main thread reads\n";
+    std::cerr << "\t--stats: print on stderr how much workers contended for the chunks and the kernels in use\n";
+    std::cerr << "\t--max-memory: bytes (or K, M, G) rows waiting to be parsed and chunks may take, threads wait when exceeded\n";
+    std::cerr << "\t--split: analyse each large chunk of all the pairs with up to TILES workers, each adding a tile of the pairs, not with GPU, SLOW or BLACKHOLE\n";
     std::cerr << "Usage:\n";
     
     exit(EXIT_FAILURE);
@@ -27,6 +43,43 @@ parsed_arguments parse(const int argc, const char *argv[]) {
         { "workers", required_argument, nullptr, 0 },
         // to specify how many rows to put in each chunk
         { "rows", required_argument, nullptr, 0 },
+        // to parse input without passing through the row queue
+        { "fused", no_argument, nullptr, 0 },
+        // to store a CSV file as a binary one
+        { "convert", no_argument, nullptr, 0 },
+        // to specify how many blocks of input to read in advance
+        { "io-depth", required_argument, nullptr, 0 },
+        // to specify the size of the blocks of input
+        { "io-block", required_argument, nullptr, 0 },
+        // to read input with O_DIRECT
+        { "direct", no_argument, nullptr, 0 },
+        // to analyse only some columns
+        { "columns", required_argument, nullptr, 0 },
+        // to analyse only pairs made by one of the columns and
+        // one of the given ones
+        { "against", required_argument, nullptr, 0 },
+        // to place workers and chunks on NUMA nodes
+        { "numa", no_argument, nullptr, 0 },
+        // to choose what idle workers do
+        { "wait", required_argument, nullptr, 0 },
+        // to specify how long idle workers spin before parking
+        { "spins", required_argument, nullptr, 0 },
+        // to pin each worker to a CPU
+        { "pin", no_argument, nullptr, 0 },
+        // to choose the CPUs workers are pinned to
+        { "cpus", required_argument, nullptr, 0 },
+        // to choose how workers share physical cores
+        { "smt", required_argument, nullptr, 0 },
+        // to give the main thread a core on its own
+        { "isolate-main", no_argument, nullptr, 0 },
+        // to parse and analyse with separate pools of workers
+        { "roles", no_argument, nullptr, 0 },
+        // to print synchronization counters at the end
+        { "stats", no_argument, nullptr, 0 },
+        // to bound the memory taken by queues and chunks
+        { "max-memory", required_argument, nullptr, 0 },
+        // to analyse large chunks with several workers
+        { "split", required_argument, nullptr, 0 },
         // last element of the array has to be filled with 0s
         {}
     };
@@ -68,6 +121,11 @@ parsed_arguments parse(const int argc, const char *argv[]) {
                 if (!optarg) {
                     throw parsing_exception("Missing value for --rows"s);
                 }
+                if (optarg == "auto"s || optarg == "adaptive"s) {
+                    ans.auto_rows = true;
+                    ans.adaptive_rows = optarg == "adaptive"s;
+                    break;
+                }
                 try
                 {
                     ans.row_count = std::stoul(optarg);
@@ -80,6 +138,155 @@ parsed_arguments parse(const int argc, const char *argv[]) {
                     throw parsing_exception("Invalid value for --rows: "s + optarg);
                 }
                 break;
+            case 2: // handle --fused
+                ans.fused = true;
+                break;
+            case 3: // handle --convert
+                ans.convert = true;
+                break;
+            case 4: // handle --io-depth
+                if (!optarg) {
+                    throw parsing_exception("Missing value for --io-depth"s);
+                }
+                try
+                {
+                    ans.io_depth = std::stoul(optarg);
+                    if (std::to_string(ans.io_depth) != optarg || ans.io_depth == 0) {
+                        throw std::exception();
+                    }
+                }
+                catch(const std::exception&)
+                {
+                    throw parsing_exception("Invalid value for --io-depth: "s + optarg);
+                }
+                break;
+            case 5: // handle --io-block
+                if (!optarg) {
+                    throw parsing_exception("Missing value for --io-block"s);
+                }
+                try
+                {
+                    ans.io_block = std::stoul(optarg);
+                    if (std::to_string(ans.io_block) != optarg || ans.io_block == 0) {
+                        throw std::exception();
+                    }
+                }
+                catch(const std::exception&)
+                {
+                    throw parsing_exception("Invalid value for --io-block: "s + optarg);
+                }
+                break;
+            case 6: // handle --direct
+                ans.direct = true;
+                break;
+            case 7: // handle --columns
+                if (!optarg || !*optarg) {
+                    throw parsing_exception("Missing value for --columns"s);
+                }
+                // names can be resolved only once the header is known
+                ans.columns = optarg;
+                break;
+            case 8: // handle --against
+                if (!optarg || !*optarg) {
+                    throw parsing_exception("Missing value for --against"s);
+                }
+                ans.against = optarg;
+                break;
+            case 9: // handle --numa
+                ans.numa = true;
+                break;
+            case 10: // handle --wait
+                if (!optarg || (optarg != "spin"s && optarg != "yield"s && optarg != "park"s)) {
+                    throw parsing_exception("Invalid value for --wait: "s + (optarg ? optarg : ""));
+                }
+                ans.wait = optarg;
+                break;
+            case 11: // handle --spins
+                if (!optarg) {
+                    throw parsing_exception("Missing value for --spins"s);
+                }
+                try
+                {
+                    ans.spins = std::stoul(optarg);
+                    if (std::to_string(ans.spins) != optarg || ans.spins == 0) {
+                        throw std::exception();
+                    }
+                }
+                catch(const std::exception&)
+                {
+                    throw parsing_exception("Invalid value for --spins: "s + optarg);
+                }
+                break;
+            case 12: // handle --pin
+                ans.pin = true;
+                break;
+            case 13: // handle --cpus
+                if (!optarg || !*optarg) {
+                    throw parsing_exception("Missing value for --cpus"s);
+                }
+                ans.cpus = optarg;
+                ans.pin = true;
+                break;
+            case 14: // handle --smt
+                if (!optarg || (optarg != "avoid"s && optarg != "pack"s)) {
+                    throw parsing_exception("Invalid value for --smt: "s + (optarg ? optarg : ""));
+                }
+                ans.smt = optarg;
+                ans.pin = true;
+                break;
+            case 15: // handle --isolate-main
+                ans.isolate_main = true;
+                ans.pin = true;
+                break;
+            case 16: // handle --roles
+                ans.roles = true;
+                break;
+            case 17: // handle --stats
+                ans.stats = true;
+                break;
+            case 18: // handle --max-memory
+                if (!optarg) {
+                    throw parsing_exception("Missing value for --max-memory"s);
+                }
+                try
+                {
+                    std::size_t end{};
+                    ans.max_memory = std::stoul(optarg, &end);
+                    const std::string unit = optarg + end;
+                    if (unit == "K") {
+                        ans.max_memory <<= 10;
+                    } else if (unit == "M") {
+                        ans.max_memory <<= 20;
+                    } else if (unit == "G") {
+                        ans.max_memory <<= 30;
+                    } else if (!unit.empty() || optarg[0] == '-') {
+                        throw std::exception();
+                    }
+                    if (ans.max_memory == 0) {
+                        throw std::exception();
+                    }
+                }
+                catch(const std::exception&)
+                {
+                    throw parsing_exception("Invalid value for --max-memory: "s + optarg);
+                }
+                break;
+            case 19: // handle --split
+                if (!optarg) {
+                    throw parsing_exception("Missing value for --split"s);
+                }
+                try
+                {
+                    ans.split = std::stoul(optarg);
+                    if (std::to_string(ans.split) != optarg || ans.split < 2) {
+                        throw std::exception();
+                    }
+                }
+                catch(const std::exception&)
+                {
+                    throw parsing_exception("Invalid value for --split: "s + optarg);
+                }
+                break;
             default:
                 throw parsing_exception("Unknow long option found: "s + longopts[longindex].name);
                 break;
@@ -89,8 +296,20 @@ parsed_arguments parse(const int argc, const char *argv[]) {
         }
     }
     
-    // take non option arguments, i.e. input file name:
-    if (optind + 1 == argc) {
+    // take non option arguments, i.e. input file name
+    // (and output file name when converting):
+    if (ans.convert) {
+        if (!ans.against.empty()) {
+            throw parsing_exception("--against cannot be used with --convert");
+        }
+        if (optind + 2 == argc) {
+            ans.input_file = argv[optind];
+            ans.output_file = argv[optind + 1];
+        } else {
+            using namespace std::literals;
+            throw parsing_exception("--convert requires input and output files"s);
+        }
+    } else if (optind + 1 == argc) {
         ans.input_file = argv[optind];
     } else {
         using namespace std::literals;
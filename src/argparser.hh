@@ -12,6 +12,51 @@ struct parsed_arguments {
     unsigned int worker_count = 0;
     // how many rows to be used per chunk, 0 means default
     std::size_t row_count = 0;
+    // choose rows per chunk from the caches (--rows auto)
+    bool auto_rows = false;
+    // and adapt them while chunks are analysed (--rows adaptive)
+    bool adaptive_rows = false;
+    // tokenize and convert input in a single step
+    bool fused = false;
+    // convert the input file into a binary file and exit
+    bool convert = false;
+    // path to the binary file produced by --convert
+    std::string output_file;
+    // how many blocks of input to be read in advance, 0 means default
+    unsigned int io_depth = 0;
+    // size in bytes of each block of input, 0 means default
+    std::size_t io_block = 0;
+    // read input bypassing the page cache
+    bool direct = false;
+    // columns to be analysed (names, indexes or ranges
+    // separated by commas), empty means all
+    std::string columns;
+    // if not empty, correlate only each column in columns
+    // (all if empty) with each column in against
+    std::string against;
+    // spread workers on the NUMA nodes, with a chunk queue per node
+    bool numa = false;
+    // what idle workers do: spin, yield or park, empty means default
+    std::string wait;
+    // stalled iterations spent spinning before parking, 0 means default
+    unsigned int spins = 0;
+    // pin each worker to a CPU
+    bool pin = false;
+    // CPUs to be used when pinning, empty means all
+    std::string cpus;
+    // avoid (default) or pack threads on the CPUs of the same core
+    std::string smt;
+    // keep a core for the main thread, which also reads the input
+    bool isolate_main = false;
+    // separate pools of parsers and analysers, balanced at runtime
+    bool roles = false;
+    // print how much workers contended for the chunks
+    bool stats = false;
+    // bytes the queues and the chunks may take, 0 means no limit
+    std::size_t max_memory = 0;
+    // split the pairs of large chunks among up to this number
+    // of workers, 0 means no split
+    unsigned int split = 0;
 };
 
 [[noreturn]] void help(const char * const exe);
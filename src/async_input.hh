@@ -0,0 +1,480 @@
+
+#ifndef ASYNC_INPUT
+#define ASYNC_INPUT
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <istream>
+#include <streambuf>
+#include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define IO_URING
+#include <linux/io_uring.h>
+#endif
+
+/**
+ * Input files read in large blocks directly into user space buffers,
+ * without the buffering of std::ifstream. On Linux reads are issued
+ * through io_uring: many blocks are being read in advance (read-ahead)
+ * while the application consumes the previous ones, so the thread
+ * reading the input (i.e. the main thread) does not block on I/O.
+ * When io_uring is not available blocks are read by pread.
+ *
+ * Files can optionally be opened with O_DIRECT to bypass the page
+ * cache, useful for huge files read only once.
+ */
+namespace async_io {
+
+    // alignment of buffers, offsets and sizes required by O_DIRECT
+    constexpr std::size_t ALIGNMENT = 4096;
+
+    struct options {
+        // number of blocks being read concurrently
+        unsigned queue_depth = 8;
+        // bytes read at once
+        std::size_t block_size = 1 << 20;
+        // bypass the page cache
+        bool direct = false;
+        // use pread even if io_uring is available
+        bool force_pread = false;
+        // if not 0, io_uring reads return at most these bytes as if
+        // the kernel completed them partially (for tests)
+        std::size_t short_reads = 0;
+    };
+
+    [[noreturn]] inline void fail(int error, const char* what, const std::string& filename) {
+        using namespace std::literals;
+        throw std::system_error(error, std::generic_category(), what + " "s + filename);
+    }
+
+    // buffer suitable for O_DIRECT
+    struct aligned_deleter {
+        void operator()(char* p) const {
+            std::free(p);
+        }
+    };
+    using aligned_buffer = std::unique_ptr<char, aligned_deleter>;
+
+    // round up size to the alignment
+    inline std::size_t align(std::size_t size) {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    inline aligned_buffer make_aligned_buffer(std::size_t size) {
+        void* p = std::aligned_alloc(ALIGNMENT, size);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return aligned_buffer(static_cast<char*>(p));
+    }
+
+    // file opened for reading, with O_DIRECT if requested and
+    // supported by the file system
+    class input_file {
+        int _fd = -1;
+        // opened with O_DIRECT?
+        bool _direct{};
+
+    public:
+        input_file(const std::string& filename, bool direct) {
+            if (direct) {
+                _fd = ::open(filename.c_str(), O_RDONLY | O_DIRECT);
+                _direct = _fd != -1;
+            }
+            if (_fd == -1) {
+                // e.g. tmpfs does not support O_DIRECT
+                _fd = ::open(filename.c_str(), O_RDONLY);
+            }
+            if (_fd == -1) {
+                fail(errno, "Cannot open", filename);
+            }
+        }
+
+        ~input_file() {
+            ::close(_fd);
+        }
+
+        input_file(const input_file&) = delete;
+        input_file& operator=(const input_file&) = delete;
+
+        int fd() const {
+            return _fd;
+        }
+
+        bool direct() const {
+            return _direct;
+        }
+    };
+
+    // stream buffer reading the file one block at a time
+    class pread_streambuf : public std::streambuf {
+        std::string filename;
+        input_file file;
+        const std::size_t block_size;
+        aligned_buffer buffer;
+        // position in the file of the next block
+        off_t offset{};
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) {
+                return traits_type::to_int_type(*gptr());
+            }
+            ssize_t n;
+            while ((n = ::pread(file.fd(), buffer.get(), block_size, offset)) == -1 && errno == EINTR);
+            if (n == -1) {
+                fail(errno, "Cannot read", filename);
+            }
+            if (n == 0) {
+                return traits_type::eof();
+            }
+            offset += n;
+            setg(buffer.get(), buffer.get(), buffer.get() + n);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        pread_streambuf(std::string filename, const options& opt)
+        : filename{std::move(filename)}, file(this->filename, opt.direct),
+          block_size{opt.block_size}, buffer{make_aligned_buffer(block_size)}
+        {
+            ::posix_fadvise(file.fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+
+        pread_streambuf(const pread_streambuf&) = delete;
+        pread_streambuf& operator=(const pread_streambuf&) = delete;
+    };
+
+#ifdef IO_URING
+    // minimal io_uring instance, used by a single thread
+    class uring {
+        int fd;
+        // submission queue
+        void* sq_ring{};
+        std::size_t sq_ring_size{};
+        unsigned* sq_tail;
+        unsigned* sq_mask;
+        unsigned* sq_array;
+        io_uring_sqe* sqes{};
+        std::size_t sqes_size{};
+        // completion queue, may share the mapping of the submission one
+        void* cq_ring{};
+        std::size_t cq_ring_size{};
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned* cq_mask;
+        io_uring_cqe* cqes;
+
+        template <typename P>
+        static P* at(void* base, std::size_t offset) {
+            return reinterpret_cast<P*>(static_cast<char*>(base) + offset);
+        }
+
+        int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+            int ret;
+            while ((ret = ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0)) == -1 && errno == EINTR);
+            return ret;
+        }
+
+        void release() {
+            if (sqes) {
+                ::munmap(sqes, sqes_size);
+            }
+            if (cq_ring && cq_ring != sq_ring) {
+                ::munmap(cq_ring, cq_ring_size);
+            }
+            if (sq_ring) {
+                ::munmap(sq_ring, sq_ring_size);
+            }
+            ::close(fd);
+        }
+
+    public:
+        // completion of a request
+        struct completion {
+            std::uint64_t user_data;
+            int result;
+        };
+
+        // throw std::system_error if io_uring is not available
+        uring(unsigned entries) {
+            io_uring_params params{};
+            fd = ::syscall(__NR_io_uring_setup, entries, &params);
+            if (fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "Cannot setup io_uring");
+            }
+            sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+            const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap) {
+                sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+            }
+            sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sq_ring == MAP_FAILED) {
+                sq_ring = nullptr;
+                const int error = errno;
+                release();
+                throw std::system_error(error, std::generic_category(), "Cannot map io_uring");
+            }
+            cq_ring = sq_ring;
+            if (!single_mmap) {
+                cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if (cq_ring == MAP_FAILED) {
+                    cq_ring = nullptr;
+                    const int error = errno;
+                    release();
+                    throw std::system_error(error, std::generic_category(), "Cannot map io_uring");
+                }
+            }
+            sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+            void* ptr = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (ptr == MAP_FAILED) {
+                const int error = errno;
+                release();
+                throw std::system_error(error, std::generic_category(), "Cannot map io_uring");
+            }
+            sqes = static_cast<io_uring_sqe*>(ptr);
+
+            sq_tail = at<unsigned>(sq_ring, params.sq_off.tail);
+            sq_mask = at<unsigned>(sq_ring, params.sq_off.ring_mask);
+            sq_array = at<unsigned>(sq_ring, params.sq_off.array);
+            cq_head = at<unsigned>(cq_ring, params.cq_off.head);
+            cq_tail = at<unsigned>(cq_ring, params.cq_off.tail);
+            cq_mask = at<unsigned>(cq_ring, params.cq_off.ring_mask);
+            cqes = at<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+        }
+
+        ~uring() {
+            release();
+        }
+
+        uring(const uring&) = delete;
+        uring& operator=(const uring&) = delete;
+
+        // submit a vectored read, at most entries requests can be pending
+        void read(int file, const iovec* vec, std::uint64_t offset, std::uint64_t user_data) {
+            const unsigned tail = *sq_tail;
+            const unsigned index = tail & *sq_mask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<std::uint64_t>(vec);
+            sqe.len = 1;
+            sqe.off = offset;
+            sqe.user_data = user_data;
+            sq_array[index] = index;
+            // make the entry visible to the kernel before the tail
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            if (enter(1, 0, 0) == -1) {
+                throw std::system_error(errno, std::generic_category(), "Cannot submit to io_uring");
+            }
+        }
+
+        // wait for the completion of a request
+        completion wait() {
+            for (;;) {
+                const unsigned head = *cq_head;
+                if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                    const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                    completion ans{cqe.user_data, cqe.res};
+                    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                    return ans;
+                }
+                if (enter(0, 1, IORING_ENTER_GETEVENTS) == -1) {
+                    throw std::system_error(errno, std::generic_category(), "Cannot wait on io_uring");
+                }
+            }
+        }
+    };
+
+    // stream buffer keeping queue_depth blocks of the file
+    // being read, consumed in order
+    class uring_streambuf : public std::streambuf {
+        std::string filename;
+        input_file file;
+        // size of the file when it was opened
+        std::size_t file_size;
+        const std::size_t block_size;
+        // see options::short_reads
+        const std::size_t short_reads;
+
+        struct slot {
+            aligned_buffer buffer;
+            iovec vec;
+            // position of the block in the file
+            std::size_t offset;
+            // bytes of the block, less than block_size at the end
+            std::size_t length;
+            // bytes read so far
+            std::size_t filled;
+            // beginning in the block of the pending request
+            std::size_t from;
+            // being read?
+            bool pending;
+        };
+        std::vector<slot> slots;
+        // slot to be consumed next, slots are consumed round robin
+        std::size_t next{};
+        // slot being consumed, if any
+        slot* current{};
+        // position of the first block not yet requested
+        std::size_t next_offset{};
+
+        // declared last: destroyed first, once all reads are done
+        uring ring;
+
+        // request the read of the remaining part of the slot
+        void submit(std::size_t i) {
+            slot& s = slots[i];
+            // O_DIRECT requires aligned offsets, addresses and sizes:
+            // after a short read the bytes from the last aligned
+            // position are read again, and the last block of the file
+            // is read by a longer request, ended by the end of file
+            s.from = file.direct() ? s.filled / ALIGNMENT * ALIGNMENT : s.filled;
+            s.vec.iov_base = s.buffer.get() + s.from;
+            s.vec.iov_len = std::min(block_size, align(s.length)) - s.from;
+            s.pending = true;
+            ring.read(file.fd(), &s.vec, s.offset + s.from, i);
+        }
+
+        // request the next block of the file into the slot, if any
+        void request(std::size_t i) {
+            slot& s = slots[i];
+            s.filled = 0;
+            s.offset = next_offset;
+            s.length = std::min(block_size, file_size - next_offset);
+            if (s.length) {
+                next_offset += s.length;
+                submit(i);
+            }
+        }
+
+        // process a completion
+        void complete() {
+            const auto c = ring.wait();
+            slot& s = slots[c.user_data];
+            s.pending = false;
+            if (c.result < 0) {
+                fail(-c.result, "Cannot read", filename);
+            }
+            const std::size_t result = short_reads ? std::min<std::size_t>(c.result, short_reads) : c.result;
+            // the end of an aligned request may go beyond the
+            // size of the file when it was opened
+            const std::size_t before = s.filled;
+            s.filled = std::min(std::max(s.filled, s.from + result), s.length);
+            if (s.filled == before) {
+                // file shrunk after being opened
+                s.length = s.filled;
+            } else if (s.filled != s.length) {
+                // short read, ask for the rest
+                submit(c.user_data);
+            }
+        }
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) {
+                return traits_type::to_int_type(*gptr());
+            }
+            if (current) {
+                // reuse the slot for the next block
+                request(current - slots.data());
+                current = nullptr;
+            }
+            slot& s = slots[next];
+            while (s.pending) {
+                complete();
+            }
+            if (!s.filled) {
+                return traits_type::eof();
+            }
+            next = (next + 1) % slots.size();
+            current = &s;
+            setg(s.buffer.get(), s.buffer.get(), s.buffer.get() + s.filled);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        uring_streambuf(std::string filename, const options& opt)
+        : filename{std::move(filename)}, file(this->filename, opt.direct),
+          block_size{opt.block_size}, short_reads{opt.short_reads}, slots(std::max(1u, opt.queue_depth)),
+          ring(std::max(1u, opt.queue_depth))
+        {
+            struct stat st;
+            if (::fstat(file.fd(), &st) == -1) {
+                fail(errno, "Cannot stat", this->filename);
+            }
+            file_size = st.st_size;
+            for (std::size_t i{}; i != slots.size(); ++i) {
+                slots[i].buffer = make_aligned_buffer(block_size);
+                slots[i].pending = false;
+                request(i);
+            }
+        }
+
+        ~uring_streambuf() {
+            // buffers must outlive pending reads
+            try {
+                for (auto& s : slots) {
+                    while (s.pending) {
+                        complete();
+                    }
+                }
+            } catch (...) {}
+        }
+
+        uring_streambuf(const uring_streambuf&) = delete;
+        uring_streambuf& operator=(const uring_streambuf&) = delete;
+    };
+#endif
+
+    // input stream over one of the stream buffers above, read
+    // errors are reported as exceptions
+    template <typename B>
+    class input_stream : public std::istream {
+        B buffer;
+
+    public:
+        input_stream(std::string filename, const options& opt)
+        : std::istream(nullptr), buffer(std::move(filename), opt)
+        {
+            rdbuf(&buffer);
+            exceptions(std::ios::badbit);
+        }
+    };
+
+    // open the given file, through io_uring if available
+    inline std::unique_ptr<std::istream> open(const std::string& filename, options opt = {}) {
+        // O_DIRECT requires aligned sizes
+        opt.block_size = std::max(ALIGNMENT, align(opt.block_size));
+#ifdef IO_URING
+        if (!opt.force_pread) {
+            try {
+                return std::make_unique<input_stream<uring_streambuf>>(filename, opt);
+            } catch (const std::system_error&) {
+                // io_uring not supported (e.g. old kernel or forbidden
+                // by seccomp), errors on the file are reported below
+            }
+        }
+#endif
+        return std::make_unique<input_stream<pread_streambuf>>(filename, opt);
+    }
+}
+
+
+#endif
@@ -0,0 +1,303 @@
+
+#ifndef BINARY_FORMAT
+#define BINARY_FORMAT
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "chunk.hh"
+#include "mapped_file.hh"
+#include "mmap_reader.hh"
+#include "column_selection.hh"
+#include "number_parsing.hh"
+
+/**
+ * Binary files holding a table of numbers, so that datasets
+ * analysed many times have to be parsed only once (see convert()).
+ * Two formats are supported, both mapped in memory and accessed
+ * in place (see binary_reader):
+ *  - the native one: a 64 bytes header made of
+ *      magic (8 bytes), rows (uint64), cols (uint64),
+ *      dtype (uint32), layout (uint32), zero padding
+ *    followed by the items, little endian;
+ *  - NumPy .npy files containing 1 or 2 dimensional arrays of
+ *    little endian floating point or integer numbers.
+ */
+namespace binary_format {
+
+    // type of the items
+    enum class dtype : std::uint32_t {
+        float32, float64, int32, int64
+    };
+
+    inline std::size_t dtype_size(dtype type) {
+        return type == dtype::float32 || type == dtype::int32 ? 4 : 8;
+    }
+
+    template <typename T>
+    constexpr dtype dtype_of() {
+        static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Only float and double can be stored");
+        return std::is_same_v<T, float> ? dtype::float32 : dtype::float64;
+    }
+
+    // layout of the items
+    enum class order : std::uint32_t {
+        by_columns, by_rows
+    };
+
+    // a table stored in a file
+    struct table {
+        std::size_t rows{}, cols{};
+        dtype type{};
+        order layout{};
+        // position of the first item w.r.t. the beginning of the file
+        std::size_t offset{};
+
+        // distance (in items) between items in adjacent rows
+        std::size_t row_offset() const {
+            return layout == order::by_columns ? 1 : cols;
+        }
+
+        // distance (in items) between items in adjacent columns
+        std::size_t column_offset() const {
+            return layout == order::by_columns ? rows : 1;
+        }
+
+        // position (in items) of (row, col) w.r.t. the first item
+        std::size_t index(std::size_t row, std::size_t col) const {
+            return row*row_offset() + col*column_offset();
+        }
+
+        // size in bytes of the items
+        std::size_t bytes() const {
+            return rows*cols*dtype_size(type);
+        }
+    };
+
+    constexpr std::size_t MAGIC_SIZE = 8;
+    constexpr char NATIVE_MAGIC[MAGIC_SIZE] = {'\x93', 'P', 'C', 'C', 'T', 'A', 'B', '1'};
+    constexpr std::size_t NATIVE_HEADER_SIZE = 64;
+    constexpr char NPY_MAGIC[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+    // .npy headers are padded to a multiple of this size
+    constexpr std::size_t NPY_ALIGNMENT = 64;
+
+    inline bool is_native(const char* data, std::size_t size) {
+        return size >= MAGIC_SIZE && std::memcmp(data, NATIVE_MAGIC, MAGIC_SIZE) == 0;
+    }
+
+    inline bool is_npy(const char* data, std::size_t size) {
+        return size >= sizeof(NPY_MAGIC) && std::memcmp(data, NPY_MAGIC, sizeof(NPY_MAGIC)) == 0;
+    }
+
+    // check the beginning of the file, without mapping it
+    inline bool is_binary(const std::string& filename) {
+        char magic[MAGIC_SIZE]{};
+        std::ifstream file(filename, std::ios::binary);
+        file.read(magic, MAGIC_SIZE);
+        return is_native(magic, file.gcount()) || is_npy(magic, file.gcount());
+    }
+
+    template <typename U>
+    U load(const char* p) {
+        U ans;
+        std::memcpy(&ans, p, sizeof(U));
+        return ans;
+    }
+
+    inline table read_native(const mapped_file& file) {
+        if (file.size() < NATIVE_HEADER_SIZE) {
+            throw std::runtime_error("Truncated header");
+        }
+        const char* p = file.data() + MAGIC_SIZE;
+        table ans;
+        ans.rows = load<std::uint64_t>(p);
+        ans.cols = load<std::uint64_t>(p + 8);
+        ans.type = static_cast<dtype>(load<std::uint32_t>(p + 16));
+        ans.layout = static_cast<order>(load<std::uint32_t>(p + 20));
+        ans.offset = NATIVE_HEADER_SIZE;
+        if (ans.type > dtype::int64 || ans.layout > order::by_rows) {
+            throw std::runtime_error("Invalid header");
+        }
+        return ans;
+    }
+
+    // value of key in the python dictionary of a .npy header, values
+    // of interest are strings, booleans or tuples of integers
+    inline std::string_view npy_value(std::string_view header, std::string_view key) {
+        auto pos = header.find(key);
+        if (pos == std::string_view::npos || (pos = header.find(':', pos)) == std::string_view::npos) {
+            throw std::runtime_error("Missing " + std::string(key) + " in .npy header");
+        }
+        header.remove_prefix(pos + 1);
+        while (!header.empty() && header.front() == ' ') {
+            header.remove_prefix(1);
+        }
+        if (!header.empty() && header.front() == '(') {
+            // tuple, closing parenthesis included
+            return header.substr(0, header.find(')') + 1);
+        }
+        return header.substr(0, header.find_first_of(",}"));
+    }
+
+    inline table read_npy(const mapped_file& file) {
+        const char* p = file.data();
+        const auto version = file.size() > sizeof(NPY_MAGIC) ? p[sizeof(NPY_MAGIC)] : 0;
+        // header length is stored in 2 bytes up to version 1.0, 4 later
+        const std::size_t length_size = version == 1 ? 2 : 4;
+        const std::size_t begin = sizeof(NPY_MAGIC) + 2 + length_size;
+        if (version < 1 || version > 3 || file.size() < begin) {
+            throw std::runtime_error("Unsupported .npy version");
+        }
+        const std::size_t length = length_size == 2 ? load<std::uint16_t>(p + begin - 2) : load<std::uint32_t>(p + begin - 4);
+        if (file.size() < begin + length) {
+            throw std::runtime_error("Truncated header");
+        }
+        const std::string_view header(p + begin, length);
+
+        table ans;
+        ans.offset = begin + length;
+
+        const auto descr = npy_value(header, "'descr'");
+        if (descr == "'<f4'") {
+            ans.type = dtype::float32;
+        } else if (descr == "'<f8'") {
+            ans.type = dtype::float64;
+        } else if (descr == "'<i4'") {
+            ans.type = dtype::int32;
+        } else if (descr == "'<i8'") {
+            ans.type = dtype::int64;
+        } else {
+            throw std::runtime_error("Unsupported .npy type " + std::string(descr));
+        }
+
+        ans.layout = npy_value(header, "'fortran_order'") == "True" ? order::by_columns : order::by_rows;
+
+        // shape: (rows,) or (rows, cols)
+        auto shape = npy_value(header, "'shape'");
+        std::size_t dims[2]{0, 1};
+        std::size_t count{};
+        for (std::size_t i{1}; i < shape.size();) {
+            if (shape[i] >= '0' && shape[i] <= '9') {
+                if (count == 2) {
+                    throw std::runtime_error("Only 1 or 2 dimensional .npy arrays are supported");
+                }
+                std::size_t dim{};
+                for (; i < shape.size() && shape[i] >= '0' && shape[i] <= '9'; ++i) {
+                    dim = dim*10 + (shape[i] - '0');
+                }
+                dims[count++] = dim;
+            } else {
+                ++i;
+            }
+        }
+        if (count == 0) {
+            throw std::runtime_error("Only 1 or 2 dimensional .npy arrays are supported");
+        }
+        ans.rows = dims[0];
+        ans.cols = dims[1];
+        return ans;
+    }
+
+    // describe the table stored in a mapped binary file
+    inline table read(const mapped_file& file) {
+        table ans;
+        if (is_native(file.data(), file.size())) {
+            ans = read_native(file);
+        } else if (is_npy(file.data(), file.size())) {
+            ans = read_npy(file);
+        } else {
+            throw std::runtime_error("Unknown binary format");
+        }
+        if (file.size() < ans.offset + ans.bytes()) {
+            throw std::runtime_error("Truncated binary file");
+        }
+        return ans;
+    }
+
+    inline std::string native_header(const table& t) {
+        std::string ans(NATIVE_HEADER_SIZE, '\0');
+        const std::uint64_t rows = t.rows, cols = t.cols;
+        const auto type = static_cast<std::uint32_t>(t.type);
+        const auto layout = static_cast<std::uint32_t>(t.layout);
+        std::memcpy(&ans[0], NATIVE_MAGIC, MAGIC_SIZE);
+        std::memcpy(&ans[MAGIC_SIZE], &rows, 8);
+        std::memcpy(&ans[MAGIC_SIZE + 8], &cols, 8);
+        std::memcpy(&ans[MAGIC_SIZE + 16], &type, 4);
+        std::memcpy(&ans[MAGIC_SIZE + 20], &layout, 4);
+        return ans;
+    }
+
+    // version 1.0 header
+    inline std::string npy_header(const table& t) {
+        using namespace std::literals;
+        const char* descr[] = {"<f4", "<f8", "<i4", "<i8"};
+        std::string dict = "{'descr': '"s + descr[static_cast<std::size_t>(t.type)]
+            + "', 'fortran_order': " + (t.layout == order::by_columns ? "True" : "False")
+            + ", 'shape': (" + std::to_string(t.rows) + ", " + std::to_string(t.cols) + "), }";
+        const std::size_t prefix = sizeof(NPY_MAGIC) + 4;
+        // pad with spaces, the header ends with a new line
+        dict.append(NPY_ALIGNMENT - (prefix + dict.size() + 1) % NPY_ALIGNMENT, ' ');
+        dict.push_back('\n');
+        std::string ans(NPY_MAGIC, sizeof(NPY_MAGIC));
+        ans.push_back('\x01');
+        ans.push_back('\x00');
+        const std::uint16_t length = dict.size();
+        ans.append(reinterpret_cast<const char*>(&length), 2);
+        return ans + dict;
+    }
+
+    // parse a CSV file (see mmap_reader) and store its content in a
+    // binary file, by rows as parsers fill chunks: the output is .npy if
+    // its name ends with .npy, native otherwise. If columns is not
+    // empty only the columns it lists are stored (see parse_columns())
+    template <typename T>
+    void convert(const std::string& input_file, const std::string& output_file, const std::string& columns = {}) {
+        using row_queue = lockfree_queue::fixed_size_lockfree_queue<row_block>;
+
+        // first pass to count rows, the file is mapped twice but
+        // it is going to be read from the page cache
+        mmap_reader counter(input_file, static_cast<row_queue*>(nullptr));
+        column_selection selection(counter.column_count());
+        if (!columns.empty()) {
+            selection = parse_columns(columns, selection.total(), read_header(input_file));
+            counter.select_columns(selection);
+        }
+        table t;
+        t.cols = counter.column_count();
+        while (counter.consume_row([](std::string_view){})) {
+            ++t.rows;
+        }
+        t.type = dtype_of<T>();
+        // as chunks filled by parsers, consumers preferring
+        // columns transpose them anyway
+        t.layout = order::by_rows;
+
+        const bool npy = output_file.size() >= 4 && output_file.compare(output_file.size() - 4, 4, ".npy") == 0;
+        const auto header = npy ? npy_header(t) : native_header(t);
+        t.offset = header.size();
+
+        mapped_output_file output(output_file, t.offset + t.bytes());
+        std::memcpy(output.data(), header.data(), header.size());
+        char* const items = output.data() + t.offset;
+
+        // second pass to convert fields
+        mmap_reader reader(input_file, static_cast<row_queue*>(nullptr));
+        reader.select_columns(selection);
+        std::size_t row{}, col{};
+        const auto on_field = [&](std::string_view field) {
+            const T value = field_to_number<T>(field);
+            std::memcpy(items + sizeof(T)*t.index(row, col++), &value, sizeof(T));
+        };
+        for (; row != t.rows && reader.consume_row(on_field); ++row) {
+            col = 0;
+        }
+    }
+}
+
+
+#endif
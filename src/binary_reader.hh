@@ -0,0 +1,203 @@
+
+#ifndef BINARY_READER
+#define BINARY_READER
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+#include "chunk.hh"
+#include "chunk_pool.hh"
+#include "mapped_file.hh"
+#include "binary_format.hh"
+#include "numeric_parser.hh"
+#include "column_selection.hh"
+
+
+/**
+ * @brief Read a binary file (see binary_format) mapping it in memory:
+ * there is nothing to parse, so chunks are directly put in the chunk
+ * queue. When the items of the file have the type of chunks, the
+ * chunks are views of the mapping (by rows or by columns, as the
+ * file) and the file is never copied. Otherwise items are converted into newly allocated chunks.
+ * Views are kept also when the selected columns (see select_columns())
+ * are adjacent.
+ *
+ * Chunks are valid as long as the reader is alive.
+ */
+template <typename T>
+class binary_reader {
+public:
+    class end_of_inputs : public std::exception {};
+private:
+    // mapped input file
+    std::shared_ptr<const mapped_file> input;
+    // table stored in the file
+    binary_format::table table;
+    // first item of the table
+    const char* items;
+    // first row not yet put in a chunk
+    std::size_t next_row{};
+    // how many rows in each chunk
+    std::size_t rows_per_chunk = numeric_parser<T>::DEFAULT_ROW_NUMBER;
+    // items have the type and the layout of chunks
+    bool compatible{};
+    // chunks refer directly to the mapping?
+    bool views{};
+    // columns put in chunks, all by default
+    column_selection selection;
+
+    // used to support smart memory management
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr;
+    // the queue will be accessed by a row pointer allowing
+    // this class to receive both smart and raw pointers
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr;
+    // if data cannot be are maintained here
+    std::unique_ptr<chunk<T>> holder;
+    // where copied chunks are taken from, if any
+    chunk_pool<T>* pool{};
+
+    // item in position (row, col)
+    T item(std::size_t row, std::size_t col) const {
+        const char* p = items + table.index(row, col)*binary_format::dtype_size(table.type);
+        switch (table.type) {
+        case binary_format::dtype::float32:
+            return static_cast<T>(binary_format::load<float>(p));
+        case binary_format::dtype::float64:
+            return static_cast<T>(binary_format::load<double>(p));
+        case binary_format::dtype::int32:
+            return static_cast<T>(binary_format::load<std::int32_t>(p));
+        default:
+            return static_cast<T>(binary_format::load<std::int64_t>(p));
+        }
+    }
+
+    // build a chunk holding the next rows
+    void fill_chunk() {
+        const auto rows = std::min(rows_per_chunk, table.rows - next_row);
+        const auto cols = selection.size();
+        if (views) {
+            const auto first = cols ? selection.column(0) : 0;
+            holder = std::make_unique<chunk<T>>(
+                reinterpret_cast<const T*>(items) + table.index(next_row, first),
+                rows, cols, table.row_offset(), table.column_offset()
+            );
+        } else {
+            holder = acquire_chunk(pool, rows, cols);
+            if (!holder) {
+                // memory budget exhausted, retry later
+                return;
+            }
+            for (std::size_t r{}; r != rows; ++r) {
+                for (std::size_t c{}; c != cols; ++c) {
+                    holder->unsafe_push_back(item(next_row + r, selection.column(c)));
+                }
+            }
+        }
+        next_row += rows;
+    }
+
+public:
+    binary_reader(std::string filename, std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr)
+    : binary_reader(std::move(filename), chunk_queue_smart_ptr.get())
+    {
+        this->chunk_queue_smart_ptr = std::move(chunk_queue_smart_ptr);
+    }
+
+    binary_reader(std::string filename, lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr)
+    : input(std::make_shared<const mapped_file>(filename)), chunk_queue_ptr{chunk_queue_ptr}
+    {
+        try {
+            table = binary_format::read(*input);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(filename + ": " + e.what());
+        }
+        items = input->data() + table.offset;
+        // chunks can have any layout (see chunk_layout)
+        compatible = table.type == binary_format::dtype_of<T>()
+            && reinterpret_cast<std::uintptr_t>(items) % alignof(T) == 0;
+#ifdef GPU
+        // the GPU consumer copies the whole span of each chunk (see
+        // chunk::size()), keep them compact
+        compatible = false;
+#endif
+        select_columns(column_selection(table.cols));
+    }
+
+    // put in chunks only the given columns, to be
+    // called before reading
+    void select_columns(column_selection selection) {
+        if (selection.total() != table.cols) {
+            throw std::logic_error("Column selection does not match input columns");
+        }
+        if (next_row) {
+            throw std::logic_error("Cannot select columns after reading has been started.");
+        }
+        this->selection = std::move(selection);
+        views = compatible && this->selection.contiguous();
+    }
+
+    void set_rows_per_chunk(std::size_t rows_per_chunk) {
+        if (next_row) {
+            throw std::logic_error("Cannot change chunk size (rows) after reading has been started.");
+        }
+        this->rows_per_chunk = rows_per_chunk;
+    }
+
+    // take copied chunks from pool instead of allocating them
+    void set_chunk_pool(chunk_pool<T>* pool) {
+        this->pool = pool;
+    }
+
+    // put the next chunk in the queue, throw end_of_inputs if
+    // there are no more rows
+    // return true if the insertion succeeded
+    bool consume_chunk() {
+        if (!holder) {
+            if (next_row == table.rows) {
+                throw end_of_inputs();
+            }
+            fill_chunk();
+            if (!holder) {
+                return false;
+            }
+        }
+        return chunk_queue_ptr->offer(holder);
+    }
+
+    // consume chunks until the queue is full and the insertion fails
+    // return true if end of input is reached and false if an
+    // enqueeing is failed
+    bool consume_many()
+    try
+    {
+        while (consume_chunk());
+        return false;
+    }
+    catch (end_of_inputs&)
+    {
+        return true;
+    }
+
+    // return the number of column in the given dataset
+    // (only the selected ones)
+    std::size_t column_count() const {
+        return selection.size();
+    }
+
+    // return the number of rows in the given dataset
+    std::size_t row_count() const {
+        return table.rows;
+    }
+
+    // are chunks views of the mapped file?
+    bool zero_copy() const {
+        return views;
+    }
+};
+
+
+#endif
@@ -3,17 +3,38 @@
 
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
+
+#include "transpose.hh"
+#include "aligned_buffer.hh"
+
+// how the items of a chunk are stored: parsers fill chunks by rows,
+// the natural order of CSV files, consumers may prefer to analyse
+// them by columns (see numeric_consumer::preferred_layout())
+enum class chunk_layout {
+    by_rows, by_columns
+};
 
 // Represent a chunk of data to be processed
 // A chunk is a collection of fixed size columns,
 // i.e. a fixed size table;
+// A chunk can also be a view of a table stored elsewhere
+// (e.g. a mapped binary file, see binary_reader), in this
+// case data are not owned and cannot be modified
+// Owned chunks start at a cache line boundary and their rows
+// (or columns) are padded to whole cache lines, see aligned_buffer
 template <typename T>
 class chunk {
 private:
     const std::size_t _rows{}, _cols{}, _sz{};
     // use only one array to speed up memory accesses
-    // and allocations 
-    std::unique_ptr<T[]> _data;
+    // and allocations, empty for views
+    aligned_buffer::buffer<T> _storage;
+    // first item of the chunk
+    T* _data;
+    // distance between items in adjacent rows (same column)
+    // and in adjacent columns (same row)
+    const std::size_t _row_offset{}, _column_offset{};
 
     // to add a simple method push_bask
     std::size_t _insert_index{};
@@ -21,46 +42,51 @@ private:
     std::size_t _insert_index_row{};
     std::size_t _insert_index_col{};
 
-    // used to eventually support data layout by rows or by columns
+    // items are inserted by rows, whatever the layout
     void inc_insert_index() {
-#ifdef STORE_BY_ROWS
-#pragma message "Organize chunks by rows..."
-        ++_insert_index;
-        if (++_insert_index_col == _cols) {
-            _insert_index_col = 0;
-            ++_insert_index_row;
-        }
-#else
-#pragma message "Organize chunks by columns..."
         // next in next column
         if (++_insert_index_col == _cols) {
             // no more column
             _insert_index_col = 0;
             ++_insert_index_row;
-            _insert_index = row_col_to_index(_insert_index_row, _insert_index_col);
+            _insert_index = _insert_index_row*_row_offset;
         } else {
-            _insert_index += _rows;
+            _insert_index += _column_offset;
         }
-#endif
     }
 
-    // used to eventually support data layout by rows or by columns
     // convert pair (row,column) into linear position
     std::size_t row_col_to_index(std::size_t row, std::size_t col) const {
-#ifdef STORE_BY_ROWS
-        // data is organized by rows
-        return row*_cols + col;
-#else
-        // data is organized by columns
-        return col*_rows + row;
-#endif
+        return row*_row_offset + col*_column_offset;
     }
 
 public:
-    chunk(std::size_t rows, std::size_t cols)
-    : _rows{rows}, _cols{cols}, _sz{rows*cols}, _data{new T[rows*cols]}
+    chunk(std::size_t rows, std::size_t cols, chunk_layout layout = chunk_layout::by_rows)
+    : _rows{rows}, _cols{cols},
+      _sz{layout == chunk_layout::by_columns
+          ? cols*aligned_buffer::leading_dimension<T>(rows)
+          : rows*aligned_buffer::leading_dimension<T>(cols)},
+      _storage{aligned_buffer::allocate<T>(_sz)}, _data{_storage.get()},
+      _row_offset{layout == chunk_layout::by_columns ? 1 : aligned_buffer::leading_dimension<T>(cols)},
+      _column_offset{layout == chunk_layout::by_columns ? aligned_buffer::leading_dimension<T>(rows) : 1}
     {}
 
+    // view of a (rows x cols) table already filled, whose item
+    // (r,c) is data[r*row_offset + c*column_offset]
+    chunk(const T* data, std::size_t rows, std::size_t cols, std::size_t row_offset, std::size_t column_offset)
+    : _rows{rows}, _cols{cols},
+      _sz{rows && cols ? (rows-1)*row_offset + (cols-1)*column_offset + 1 : 0},
+      // never written through, see push_back() and clear()
+      _data{const_cast<T*>(data)},
+      _row_offset{row_offset}, _column_offset{column_offset},
+      _insert_index{_sz}, _insert_index_row{rows}
+    {}
+
+    // is data stored elsewhere?
+    bool is_view() const {
+        return !_storage;
+    }
+
     chunk& unsafe_push_back(T value) {
         _data[_insert_index] = value;
         inc_insert_index();
@@ -89,7 +115,46 @@ public:
         return _data[pos];
     }
 
+    // replace the content of this chunk with the rows of other,
+    // converting them to the layout of this chunk
+    chunk& assign(const chunk& other) {
+        if (is_view()) {
+            throw std::logic_error("Cannot assign a chunk view");
+        }
+        if (other.rows() > _rows || other.cols() != _cols) {
+            throw std::length_error("Chunk too small to be assigned");
+        }
+        transpose::copy(
+            other.data(), other.row_offset(), other.column_offset(),
+            _data, _row_offset, _column_offset,
+            other.rows(), _cols
+        );
+        _insert_index_row = other.rows();
+        _insert_index_col = 0;
+        _insert_index = row_col_to_index(_insert_index_row, 0);
+        return *this;
+    }
+
+    // set to zero the items after the last row up to the next cache
+    // line of each column, when stored by columns, and return the
+    // rows that can then be processed as a whole: kernels reading
+    // whole cache lines need no special case for the last items
+    std::size_t zero_padding() {
+        if (is_view() || stored_by_rows()) {
+            return rows();
+        }
+        constexpr std::size_t lanes = aligned_buffer::lanes<T>();
+        const std::size_t padded = (rows() + lanes - 1) / lanes * lanes;
+        for (std::size_t c{}; c != _cols; ++c) {
+            std::fill(get_column(c) + rows(), get_column(c) + padded, T{});
+        }
+        return padded;
+    }
+
     chunk& clear() {
+        if (is_view()) {
+            throw std::logic_error("Cannot clear a chunk view");
+        }
         // clearing effectively the buffer is unnecessary
         _insert_index = 0;
         _insert_index_col = 0;
@@ -133,48 +198,42 @@ public:
         return _insert_index_col == 0 && _insert_index_row == _rows;
     }
 
-    // get raw pointer to the beginnin of the giwen column
+    // get raw pointer to the beginnin of the giwen column,
+    // columns are column_offset() items apart
     T* get_column(std::size_t c) {
-#ifdef STORE_BY_ROWS
-        return &_data[c];
-#else
-        return &_data[c*_rows];
-#endif
+        return &_data[c*_column_offset];
     }
 
     T* get_row(std::size_t r) {
-#ifdef STORE_BY_ROWS
-        return &_data[r*_cols];
-#else
-        return &_data[r];
-#endif
+        return &_data[r*_row_offset];
     }
 
     // true in elements in the same column are stored sequentially
     bool stored_by_columns() const {
-#ifdef STORE_BY_ROWS
-        return false;
-#else
-        return true;
-#endif
+        return _row_offset == 1;
     }
 
     bool stored_by_rows() const {
         return !stored_by_columns();
     }
 
-    // total size of the chunk
+    chunk_layout layout() const {
+        return stored_by_columns() ? chunk_layout::by_columns : chunk_layout::by_rows;
+    }
+
+    // total size of the chunk, i.e. items between data() and
+    // end(): it includes the padding and, for views, items not in the chunk
     std::size_t size() const {
         return _sz;
     }
 
     // access directly the underlying vector
     T* data() {
-        return _data.get();
+        return _data;
     }
 
     const T* data() const {
-        return _data.get();
+        return _data;
     }
 
     T* begin() {
@@ -197,15 +256,30 @@ public:
     // between items in the same row and adjacent
     // column
     std::size_t column_offset() const {
-        return stored_by_columns() ? _rows : 1;
+        return _column_offset;
     }
 
     // offset (w.r.t. data(), pointer arithmetic)
     // between items in the same column and adjacent
     // row
     std::size_t row_offset() const {
-        return stored_by_columns() ? 1 : _cols;
+        return _row_offset;
     }
 };
 
+
+// return cnk, if its layout is the given one, otherwise a copy of
+// cnk with that layout stored in scratch, allocated only if missing
+// or too small: a consumer keeps it to transpose all its chunks
+template <typename T>
+chunk<T>& with_layout(chunk<T>& cnk, chunk_layout layout, std::unique_ptr<chunk<T>>& scratch) {
+    if (cnk.layout() == layout) {
+        return cnk;
+    }
+    if (!scratch || scratch->max_rows() < cnk.rows() || scratch->cols() != cnk.cols()) {
+        scratch = std::make_unique<chunk<T>>(cnk.max_rows(), cnk.cols(), layout);
+    }
+    return scratch->assign(cnk);
+}
+
 #endif
@@ -0,0 +1,129 @@
+
+#ifndef CHUNK_POOL
+#define CHUNK_POOL
+
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "chunk.hh"
+#include "memory_budget.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+/**
+ * @brief Chunks already analysed are given back by consumers to the
+ * pool and reused by parsers, so once all the chunks in flight have
+ * been allocated no more allocations are performed and the buffers
+ * reused are likely still in cache.
+ *
+ * The pool keeps at most capacity free chunks: chunks given back
+ * when it is full are deleted. A chunk is allocated only when the
+ * pool is empty, so the number of chunks alive is bounded by the
+ * chunks that can be queued or held by the threads.
+ *
+ * With a memory budget, chunks are allocated only while their bytes
+ * fit in it, otherwise acquire() fails and callers retry later; free
+ * chunks are deleted instead of kept while some allocation is
+ * waiting, so pools of other NUMA nodes can use their bytes.
+ */
+template <typename T>
+class chunk_pool {
+    // chunks ready to be reused
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>> free_chunks;
+    // chunks allocated because the pool was empty
+    std::atomic_size_t _allocations{};
+    // if any, bytes of the chunks alive are taken from it
+    memory_budget* budget{};
+
+    void destroy(std::unique_ptr<chunk<T>>& cnk) {
+        if (budget && cnk) {
+            budget->release(bytes(cnk->max_rows(), cnk->cols()));
+        }
+        cnk.reset();
+    }
+
+public:
+    // bytes taken by a chunk of the given size, whatever its layout
+    static std::size_t bytes(std::size_t rows, std::size_t cols) {
+        return std::max(rows*aligned_buffer::leading_dimension<T>(cols), cols*aligned_buffer::leading_dimension<T>(rows))*sizeof(T);
+    }
+
+    chunk_pool(std::size_t capacity)
+    : free_chunks(capacity)
+    {}
+
+    chunk_pool(const chunk_pool&) = delete;
+    chunk_pool& operator=(const chunk_pool&) = delete;
+
+    // chunks kept by the pool are not accounted anymore
+    ~chunk_pool() {
+        std::unique_ptr<chunk<T>> cnk;
+        while (free_chunks.poll(cnk)) {
+            destroy(cnk);
+        }
+    }
+
+    // must be called before any chunk is acquired
+    void set_budget(memory_budget* budget) {
+        this->budget = budget;
+    }
+
+    // get an empty chunk of the given size, nullptr if
+    // the budget is exhausted
+    std::unique_ptr<chunk<T>> acquire(std::size_t rows, std::size_t cols) {
+        std::unique_ptr<chunk<T>> ans;
+        // all chunks have usually the same size, the
+        // others are simply dropped
+        if (free_chunks.poll(ans)) {
+            if (ans->max_rows() == rows && ans->cols() == cols) {
+                return ans;
+            }
+            destroy(ans);
+        }
+        if (budget && !budget->try_acquire(bytes(rows, cols))) {
+            return nullptr;
+        }
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::make_unique<chunk<T>>(rows, cols);
+    }
+
+    // give back a chunk no more used, cnk is always
+    // left empty; views are not reused
+    void recycle(std::unique_ptr<chunk<T>>& cnk) {
+        if (cnk && !cnk->is_view()) {
+            cnk->clear();
+            if (!(budget && budget->pressure())) {
+                free_chunks.offer(cnk);
+            }
+            // not kept, if still there
+            destroy(cnk);
+        }
+        cnk.reset();
+    }
+
+    // number of chunks allocated so far
+    std::size_t allocations() const {
+        return _allocations.load(std::memory_order_relaxed);
+    }
+};
+
+
+// get a chunk from pool, if any, or allocate it; with a
+// memory budget it may fail returning nullptr
+template <typename T>
+std::unique_ptr<chunk<T>> acquire_chunk(chunk_pool<T>* pool, std::size_t rows, std::size_t cols) {
+    return pool ? pool->acquire(rows, cols) : std::make_unique<chunk<T>>(rows, cols);
+}
+
+// give back a chunk to pool, if any, or delete it
+template <typename T>
+void recycle_chunk(chunk_pool<T>* pool, std::unique_ptr<chunk<T>>& cnk) {
+    if (pool) {
+        pool->recycle(cnk);
+    } else {
+        cnk.reset();
+    }
+}
+
+
+#endif
@@ -0,0 +1,164 @@
+
+#ifndef CHUNK_SPLIT
+#define CHUNK_SPLIT
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "chunk.hh"
+#include "wait_strategy.hh"
+
+/**
+ * @brief Chunks analysed by several workers at once (--split): with
+ * thousands of columns a single chunk takes tens of milliseconds, and
+ * short files do not have enough chunks to keep every worker busy.
+ *
+ * The worker taking a large chunk publishes it on a board shared by
+ * all the workers. The triangle of pairs is split in tiles of about
+ * the same number of pairs (see column_pairs::pair_at()). Any worker
+ * may then take a tile and add its pairs to its own partial results,
+ * which are summed at the end anyway. The chunk is read-only while
+ * shared, and the worker completing its last tile recycles it.
+ */
+namespace chunk_split {
+
+    // products of pairs by rows below which a tile is not worth
+    // the synchronization of the workers sharing it
+    constexpr std::size_t MIN_TILE_PRODUCTS = std::size_t(1) << 22;
+
+    // tiles a chunk of rows rows with pairs pairs is split into,
+    // at most max_tiles: 1 if it is analysed by a worker alone
+    inline std::size_t tiles_for(std::size_t pairs, std::size_t rows, std::size_t max_tiles) {
+        return std::max<std::size_t>(1, std::min(max_tiles, pairs*rows / MIN_TILE_PRODUCTS));
+    }
+
+    /**
+     * @brief A chunk and the tiles of its pairs not yet taken.
+     */
+    template <typename T>
+    class shared_chunk {
+        std::unique_ptr<chunk<T>> cnk;
+        // copy of cnk with the layout asked, if different
+        std::unique_ptr<chunk<T>> copy;
+        const std::size_t _tiles;
+        // next tile to be taken
+        std::atomic_size_t next{};
+        // tiles analysed
+        std::atomic_size_t done{};
+        // when the chunk was shared
+        const std::chrono::steady_clock::time_point _shared_at{std::chrono::steady_clock::now()};
+
+    public:
+        shared_chunk(std::unique_ptr<chunk<T>> cnk, chunk_layout layout, std::size_t tiles)
+        : cnk{std::move(cnk)}, _tiles{tiles}
+        {
+            // shared read-only, not copied by each worker
+            with_layout(*this->cnk, layout, copy);
+        }
+
+        shared_chunk(const shared_chunk&) = delete;
+        shared_chunk& operator=(const shared_chunk&) = delete;
+
+        // take the next tile, if any
+        bool take(std::size_t& tile) {
+            if (exhausted()) {
+                return false;
+            }
+            tile = next.fetch_add(1, std::memory_order_relaxed);
+            return tile < _tiles;
+        }
+
+        bool exhausted() const {
+            return next.load(std::memory_order_relaxed) >= _tiles;
+        }
+
+        // a tile taken has been analysed, return true for the last
+        // one: the chunk is no more read and can be released
+        bool complete() {
+            return done.fetch_add(1, std::memory_order_acq_rel) + 1 == _tiles;
+        }
+
+        std::size_t tiles() const {
+            return _tiles;
+        }
+
+        // time since the chunk was shared, once the last tile is
+        // complete it is how long the consumers took to analyse it
+        std::uint64_t elapsed_ns() const {
+            const auto elapsed = std::chrono::steady_clock::now() - _shared_at;
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        }
+
+        // the chunk, with the layout asked
+        const chunk<T>& get() const {
+            return copy ? *copy : *cnk;
+        }
+
+        // the chunk received, once all the tiles are complete
+        std::unique_ptr<chunk<T>> release() {
+            copy.reset();
+            return std::move(cnk);
+        }
+    };
+
+    /**
+     * @brief Chunks shared by the workers, with tiles not yet taken.
+     * At most a chunk per worker is shared at once: a lock is enough.
+     */
+    template <typename T>
+    class board {
+        const std::size_t _max_tiles;
+        // parked workers are woken up when a chunk is shared
+        waiting::eventcount* const activity;
+        std::vector<std::shared_ptr<shared_chunk<T>>> chunks;
+        std::mutex lock;
+        // read by the workers without locking
+        std::atomic_size_t _size{};
+
+    public:
+        board(std::size_t max_tiles, waiting::eventcount* activity = nullptr)
+        : _max_tiles{max_tiles}, activity{activity}
+        {}
+
+        board(const board&) = delete;
+        board& operator=(const board&) = delete;
+
+        std::size_t max_tiles() const {
+            return _max_tiles;
+        }
+
+        void publish(std::shared_ptr<shared_chunk<T>> shared) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                chunks.push_back(std::move(shared));
+                _size.store(chunks.size(), std::memory_order_relaxed);
+            }
+            if (activity) {
+                activity->notify_all();
+            }
+        }
+
+        // a chunk with tiles to be taken, if any, the ones
+        // without are removed from the board
+        std::shared_ptr<shared_chunk<T>> find() {
+            // cheap check, chunks are rarely shared
+            if (!_size.load(std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [](const auto& shared){
+                return shared->exhausted();
+            }), chunks.end());
+            _size.store(chunks.size(), std::memory_order_relaxed);
+            return chunks.empty() ? nullptr : chunks.front();
+        }
+    };
+}
+
+
+#endif
@@ -0,0 +1,124 @@
+
+#ifndef CHUNK_TUNING
+#define CHUNK_TUNING
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+#include "aligned_buffer.hh"
+#include "topology.hh"
+#include "triangular_accumulator.hh"
+
+/**
+ * @brief Choice of the rows of each chunk (--rows auto): chunks
+ * should be small enough to be still in cache when analysed, large
+ * enough for the cost of passing them through queues to be
+ * negligible.
+ *
+ * If the partial results of the accumulator of all the pairs fit in
+ * L2 together with the chunk, chunks take the rest of L2, otherwise
+ * they take a quarter of it and partial results are streamed from the
+ * outer caches once per block of rows (see triangular_pcc_accumulator):
+ * chunks have at least a block of rows not to stream them more often.
+ * Half of the space is left for the transposed copy of consumers
+ * preferring the other layout (see with_layout()).
+ */
+namespace chunk_tuning {
+
+    // bound for the rows of a chunk
+    constexpr std::size_t MAX_ROWS = 1 << 16;
+
+    // rows of chunks with cols columns of T fitting the caches
+    template <typename T>
+    std::size_t rows_for(std::size_t cols, const topology::cache_sizes& caches) {
+        constexpr std::size_t lanes = aligned_buffer::lanes<T>();
+        const std::size_t row_bytes = aligned_buffer::leading_dimension<T>(cols)*sizeof(T);
+        // sums of products, of items and of squares
+        const std::size_t accumulator_bytes = (cols*(std::max<std::size_t>(cols, 1)-1)/2 + 2*cols)*sizeof(T);
+        const bool resident = accumulator_bytes <= caches.l2/2;
+        const std::size_t budget = resident ? (caches.l2 - accumulator_bytes)/2 : caches.l2/4;
+        // whole cache lines of each column when stored by columns
+        std::size_t rows = budget / row_bytes / lanes * lanes;
+        if (!resident) {
+            rows = std::max(rows, triangular_pcc_accumulator<T>::BLOCK_ROWS);
+        }
+        return std::clamp(rows, lanes, MAX_ROWS);
+    }
+
+    /**
+     * @brief Adapt the rows of new chunks while they are analysed
+     * (--rows adaptive), starting from rows_for(): consumers report
+     * the time taken by each chunk and how often they found their
+     * queue empty. Every WINDOW chunks:
+     *  - if chunks take less than MIN_CHUNK_NS each, the cost of
+     *    queues is relevant and rows are doubled;
+     *  - if consumers found the queue empty more often than not and
+     *    chunks take more than MAX_CHUNK_NS each, work is split in
+     *    too few pieces to keep all consumers busy and rows are halved.
+     * Rows stay between 1/8 and 8 times the initial ones. Counters
+     * are updated without locks, statistics are approximate.
+     */
+    class tuner {
+        static constexpr std::uint64_t WINDOW = 64;
+        static constexpr std::uint64_t MIN_CHUNK_NS = 50000;
+        static constexpr std::uint64_t MAX_CHUNK_NS = 2000000;
+
+        const std::size_t min_rows, max_rows;
+        std::atomic_size_t _rows;
+        // statistics of the current window
+        std::atomic<std::uint64_t> chunks{}, busy_ns{}, empty_polls{};
+        // how many times rows changed
+        std::atomic_size_t _changes{};
+
+        void adapt() {
+            const std::uint64_t ns_per_chunk = busy_ns.exchange(0, std::memory_order_relaxed) / WINDOW;
+            const bool starving = empty_polls.exchange(0, std::memory_order_relaxed) > WINDOW;
+            std::size_t rows = _rows.load(std::memory_order_relaxed);
+            if (ns_per_chunk < MIN_CHUNK_NS && rows < max_rows) {
+                rows = std::min(max_rows, rows*2);
+            } else if (starving && ns_per_chunk > MAX_CHUNK_NS && rows > min_rows) {
+                rows = std::max(min_rows, rows/2);
+            } else {
+                return;
+            }
+            _rows.store(rows, std::memory_order_relaxed);
+            _changes.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    public:
+        tuner(std::size_t rows)
+        : min_rows{std::max<std::size_t>(1, rows/8)}, max_rows{std::min(MAX_ROWS, rows*8)}, _rows{rows}
+        {}
+
+        // rows of the next chunk to be filled
+        std::size_t rows() const {
+            return _rows.load(std::memory_order_relaxed);
+        }
+
+        // a consumer analysed a chunk of chunk_rows rows in ns
+        void chunk_analysed(std::size_t chunk_rows, std::uint64_t ns) {
+            // chunks filled before the last change
+            if (chunk_rows != rows()) {
+                return;
+            }
+            busy_ns.fetch_add(ns, std::memory_order_relaxed);
+            if (chunks.fetch_add(1, std::memory_order_relaxed) + 1 == WINDOW) {
+                chunks.store(0, std::memory_order_relaxed);
+                adapt();
+            }
+        }
+
+        // a consumer found no chunk to analyse
+        void queue_empty() {
+            empty_polls.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::size_t changes() const {
+            return _changes.load(std::memory_order_relaxed);
+        }
+    };
+}
+
+
+#endif
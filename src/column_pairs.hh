@@ -0,0 +1,92 @@
+
+#ifndef COLUMN_PAIRS
+#define COLUMN_PAIRS
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Pairs of chunk columns whose correlation is computed:
+ * either all the pairs (c1, c2) with c1 < c2 (upper triangle, the
+ * default) or each column of a set A with each column of a set B
+ * (rectangle, see --against), which is much cheaper when one of the
+ * sets is small.
+ *
+ * Results are ordered as the pairs: in the rectangle each column of
+ * A is followed by all the columns of B.
+ */
+class column_pairs {
+    // columns of each chunk
+    std::size_t _cols;
+    // columns of the rectangle, empty for the triangle
+    std::vector<std::size_t> _a, _b;
+
+public:
+    // all the pairs of cols columns
+    column_pairs(std::size_t cols)
+    : _cols{cols}
+    {}
+
+    // each column in a with each column in b
+    column_pairs(std::size_t cols, std::vector<std::size_t> a, std::vector<std::size_t> b)
+    : _cols{cols}, _a{std::move(a)}, _b{std::move(b)}
+    {
+        if (_a.empty() || _b.empty()) {
+            throw std::invalid_argument("Both sides of a rectangle of pairs must have some column");
+        }
+        for (const auto* side : {&_a, &_b}) {
+            for (const auto c : *side) {
+                if (c >= cols) {
+                    throw std::out_of_range("Column of pair out of chunk");
+                }
+            }
+        }
+    }
+
+    bool rectangular() const {
+        return !_a.empty();
+    }
+
+    // number of columns of each chunk
+    std::size_t cols() const {
+        return _cols;
+    }
+
+    // number of pairs
+    std::size_t size() const {
+        return rectangular() ? _a.size()*_b.size() : _cols*(_cols-1)/2;
+    }
+
+    // the p-th pair (c1, c2) of the triangle of cols columns, by the
+    // closed form of fast_pair() in cuda_numeric_consumer.hh, fixed
+    // where floating point rounding picks the wrong c1
+    static std::pair<std::size_t, std::size_t> pair_at(std::size_t cols, std::size_t p) {
+        // index of the pair (c1, c1+1)
+        const auto start = [cols](std::size_t c1) {
+            return c1*(2*cols - c1 - 1)/2;
+        };
+        const double to_square = 2.0*cols - 1;
+        std::size_t c1 = std::floor((to_square - std::sqrt(std::max(0.0, to_square*to_square - 8.0*p))) / 2);
+        while (c1 > 0 && start(c1) > p) {
+            --c1;
+        }
+        while (c1 + 2 < cols && start(c1 + 1) <= p) {
+            ++c1;
+        }
+        return {c1, p - start(c1) + c1 + 1};
+    }
+
+    // sides of the rectangle
+    const std::vector<std::size_t>& a() const {
+        return _a;
+    }
+    const std::vector<std::size_t>& b() const {
+        return _b;
+    }
+};
+
+
+#endif
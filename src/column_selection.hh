@@ -0,0 +1,191 @@
+
+#ifndef COLUMN_SELECTION
+#define COLUMN_SELECTION
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "decompressor.hh"
+
+/**
+ * @brief Columns of the input to be analysed (see --columns). The
+ * readers skip the other ones while tokenizing: they are never
+ * converted and chunks only hold the selected columns, so both
+ * parsing and computations scale with the selection.
+ *
+ * Selected columns are kept in increasing order: in chunks and in
+ * results column i refers to column(i) of the input.
+ */
+class column_selection {
+    // for each column of the input, is it selected?
+    std::vector<char> keep;
+    // selected columns, in increasing order
+    std::vector<std::size_t> columns;
+
+public:
+    // select all the columns
+    column_selection(std::size_t total = 0)
+    : keep(total, 1)
+    {
+        columns.reserve(total);
+        for (std::size_t c{}; c != total; ++c) {
+            columns.push_back(c);
+        }
+    }
+
+    // select only the given columns, in increasing order
+    column_selection(std::vector<std::size_t> columns, std::size_t total)
+    : keep(total, 0), columns{std::move(columns)}
+    {
+        for (std::size_t i{}; i != this->columns.size(); ++i) {
+            const auto c = this->columns[i];
+            if (c >= total || (i && c <= this->columns[i-1])) {
+                throw std::out_of_range("Invalid column selection");
+            }
+            keep[c] = 1;
+        }
+    }
+
+    // is the given column of the input selected?
+    bool selected(std::size_t c) const {
+        return keep[c];
+    }
+
+    // input column corresponding to the i-th selected one
+    std::size_t column(std::size_t i) const {
+        return columns[i];
+    }
+
+    // number of columns of the input
+    std::size_t total() const {
+        return keep.size();
+    }
+
+    // number of selected columns
+    std::size_t size() const {
+        return columns.size();
+    }
+
+    bool all() const {
+        return size() == total();
+    }
+
+    // are the selected columns adjacent?
+    bool contiguous() const {
+        return columns.empty() || columns.back() - columns.front() + 1 == columns.size();
+    }
+
+    // position in this selection of each column selected by
+    // subset, all of them must be selected here too
+    std::vector<std::size_t> positions(const column_selection& subset) const {
+        std::vector<std::size_t> ans;
+        ans.reserve(subset.size());
+        for (const auto c : subset.columns) {
+            const auto it = std::lower_bound(columns.begin(), columns.end(), c);
+            if (it == columns.end() || *it != c) {
+                throw std::out_of_range("Column not in selection");
+            }
+            ans.push_back(it - columns.begin());
+        }
+        return ans;
+    }
+
+    // columns selected by any of the two selections
+    friend column_selection operator|(const column_selection& s1, const column_selection& s2) {
+        if (s1.total() != s2.total()) {
+            throw std::logic_error("Column selections of different inputs");
+        }
+        std::vector<std::size_t> ans;
+        std::set_union(s1.columns.begin(), s1.columns.end(), s2.columns.begin(), s2.columns.end(), std::back_inserter(ans));
+        return column_selection(std::move(ans), s1.total());
+    }
+};
+
+
+// names of the columns, read from the header of a CSV file
+inline std::vector<std::string> read_header(const std::string& filename) {
+    const auto in = compression::open(filename);
+    std::string line;
+    while (std::getline(*in, line) && line.find_first_not_of("\r") == std::string::npos);
+    // skip UTF-8 BOM, if any
+    if (line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        line.erase(0, 3);
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    std::vector<std::string> ans(1);
+    bool quoted{};
+    for (std::size_t i{}; i != line.size(); ++i) {
+        const char c = line[i];
+        if (c == '"') {
+            // "" inside quotes is a quote
+            if (quoted && i+1 != line.size() && line[i+1] == '"') {
+                ans.back().push_back(c);
+                ++i;
+            } else {
+                quoted = !quoted;
+            }
+        } else if (c == ',' && !quoted) {
+            ans.emplace_back();
+        } else {
+            ans.back().push_back(c);
+        }
+    }
+    return ans;
+}
+
+// select the columns listed in spec, separated by commas: each item
+// is the name of a column (if names are given), an index or a range
+// of indexes such as 3-7 (both included) or 3- (up to the last one).
+// Indexes start from 0, as in the output
+inline column_selection parse_columns(const std::string& spec, std::size_t total, const std::vector<std::string>& names = {}) {
+    using namespace std::literals;
+    std::vector<std::size_t> ans;
+    std::size_t pos{};
+    do {
+        auto next = spec.find(',', pos);
+        if (next == std::string::npos) {
+            next = spec.size();
+        }
+        std::string item = spec.substr(pos, next - pos);
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        pos = next + 1;
+
+        const auto name = std::find(names.begin(), names.end(), item);
+        if (!item.empty() && name != names.end()) {
+            ans.push_back(name - names.begin());
+            continue;
+        }
+        // index or range
+        const auto digits = item.find_first_not_of("0123456789");
+        if (item.empty() || digits == 0 || (digits != std::string::npos
+            && (item[digits] != '-' || item.find_first_not_of("0123456789", digits+1) != std::string::npos))
+        ) {
+            throw std::runtime_error("Unknown column in selection: \""s + item + "\"");
+        }
+        const std::size_t first = std::stoul(item);
+        std::size_t last = first;
+        if (digits != std::string::npos) {
+            last = digits+1 == item.size() ? total-1 : std::stoul(item.substr(digits+1));
+        }
+        if (last >= total || first > last) {
+            throw std::runtime_error("Column range \""s + item + "\" out of [0, " + std::to_string(total) + ")");
+        }
+        for (auto c = first; c <= last; ++c) {
+            ans.push_back(c);
+        }
+    } while (pos <= spec.size());
+
+    std::sort(ans.begin(), ans.end());
+    ans.erase(std::unique(ans.begin(), ans.end()), ans.end());
+    return column_selection(std::move(ans), total);
+}
+
+
+#endif
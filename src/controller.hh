@@ -1,23 +1,75 @@
-
 #ifndef CONTROLLER
 #define CONTROLLER
 
-#include <vector>
-#include <string>
+#include <memory>
 #include <thread>
+#include <atomic>
+#include <chrono>
 
-#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
-
-#include "chunk.hh"
+#include "queues.hh"
+#include "stage_roles.hh"
 
-// Floating point type to be used
+/**
+ * @brief Thread moving workers between the pool of parsers and the
+ * pool of analysers (see stage_roles.hh): every PERIOD, the pool
+ * starving downstream takes a worker of the other one.
+ *
+ * It stops when parsing is over: then every worker analyses.
+ */
 template <typename T>
 class controller {
+    static constexpr std::chrono::milliseconds PERIOD{2};
+
+    std::shared_ptr<queues<T>> data_queues;
+    std::thread controller_thread;
+    std::atomic_bool stopped{};
+    // workers moved so far
+    std::size_t _moves{};
+
+public:
+    controller(std::shared_ptr<queues<T>> data_queues)
+    : data_queues{std::move(data_queues)}
+    {}
+
+    controller(const controller&) = delete;
+    controller& operator=(const controller&) = delete;
+
+    ~controller() {
+        stop();
+    }
+
+    // look at the last period and move a worker, if needed
+    void rebalance() {
+        auto& roles = *data_queues->roles;
+        const auto needed = stage_roles::needed(roles.take(data_queues->backlog()));
+        if (needed == stage_roles::role::parse) {
+            _moves += roles.move(stage_roles::role::compute, stage_roles::role::parse);
+        } else if (needed == stage_roles::role::compute) {
+            _moves += roles.move(stage_roles::role::parse, stage_roles::role::compute);
+        }
+    }
+
+    void start() {
+        controller_thread = std::thread([this](){
+            while (!stopped.load() && !data_queues->test_end_of_str2num() && !data_queues->test_aborted()) {
+                std::this_thread::sleep_for(PERIOD);
+                rebalance();
+            }
+            data_queues->roles->clear();
+            data_queues->notify();
+        });
+    }
 
-    // lock free queue containing vectors of strings to be
-    // converted to floating points
-    lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>> rows;
+    void stop() {
+        stopped.store(true);
+        if (controller_thread.joinable()) {
+            controller_thread.join();
+        }
+    }
 
+    std::size_t moves() const {
+        return _moves;
+    }
 };
 
 
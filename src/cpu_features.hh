@@ -0,0 +1,47 @@
+
+#ifndef CPU_FEATURES
+#define CPU_FEATURES
+
+/**
+ * Runtime detection of the instruction set extensions supported
+ * by the CPU, used to select the best implementation of the
+ * vectorized routines when the program starts.
+ *
+ * SIMD routines are compiled only on x86-64 and outside nvcc,
+ * whose front-end does not handle target specific intrinsics:
+ * the scalar fallback is used everywhere else.
+ */
+
+#if defined(__x86_64__) && !defined(__CUDACC__)
+#define X86_SIMD
+#endif
+
+namespace cpu_features {
+
+    inline bool has_avx2() {
+#ifdef X86_SIMD
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    inline bool has_fma() {
+#ifdef X86_SIMD
+        return __builtin_cpu_supports("fma");
+#else
+        return false;
+#endif
+    }
+
+    inline bool has_avx512f() {
+#ifdef X86_SIMD
+        return __builtin_cpu_supports("avx512f");
+#else
+        return false;
+#endif
+    }
+}
+
+
+#endif
@@ -0,0 +1,178 @@
+
+#ifndef CSV_SCANNER
+#define CSV_SCANNER
+
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.hh"
+
+#ifdef X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Find the structural characters of a CSV (separators
+ * outside quoted fields) 64 bytes at a time, in the style of
+ * simdjson: each window of input is classified into bitmasks, the
+ * quoted regions are obtained by a prefix xor of the quotes mask
+ * and removed from the separators mask. Fields are then obtained
+ * by iterating over the bits of the mask, whatever they are quoted
+ * or not, so the "1","2" dialect is handled without looking at
+ * each char.
+ *
+ * The classification routine is selected at runtime between AVX2,
+ * SSE2 and a scalar fallback.
+ */
+class csv_scanner {
+public:
+    // bytes classified at once
+    static constexpr std::size_t WINDOW = 64;
+
+    // interesting chars found in a window, bit i refers to byte i
+    struct masks {
+        // '"'
+        std::uint64_t quotes;
+        // ',' and '\n'
+        std::uint64_t separators;
+    };
+    // routine used to classify a window of WINDOW bytes
+    using classifier = masks (*)(const char*);
+
+    static masks classify_scalar(const char* p) {
+        masks ans{};
+        for (std::size_t i{}; i != WINDOW; ++i) {
+            const std::uint64_t bit = std::uint64_t(1) << i;
+            ans.quotes |= p[i] == '"' ? bit : 0;
+            ans.separators |= (p[i] == ',' || p[i] == '\n') ? bit : 0;
+        }
+        return ans;
+    }
+
+#ifdef X86_SIMD
+    // SSE2 is always available on x86-64; SSE4.2 adds nothing
+    // to it here: its string instructions (pcmpistrm) are slower
+    // than byte comparisons and give a single mask per call
+    static masks classify_sse2(const char* p) {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i newline = _mm_set1_epi8('\n');
+        masks ans{};
+        for (std::size_t i{}; i != WINDOW; i += 16) {
+            const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            const std::uint64_t q = std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(in, quote)));
+            const std::uint64_t s = std::uint16_t(_mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(in, comma), _mm_cmpeq_epi8(in, newline))));
+            ans.quotes |= q << i;
+            ans.separators |= s << i;
+        }
+        return ans;
+    }
+
+    __attribute__((target("avx2")))
+    static masks classify_avx2(const char* p) {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        masks ans{};
+        for (std::size_t i{}; i != WINDOW; i += 32) {
+            const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            const std::uint64_t q = std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, quote)));
+            const std::uint64_t s = std::uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpeq_epi8(in, comma), _mm256_cmpeq_epi8(in, newline))));
+            ans.quotes |= q << i;
+            ans.separators |= s << i;
+        }
+        return ans;
+    }
+#endif
+
+    // best classification routine supported by the CPU
+    static classifier best_classifier() {
+#ifdef X86_SIMD
+        static const classifier best = cpu_features::has_avx2() ? classify_avx2 : classify_sse2;
+        return best;
+#else
+        return classify_scalar;
+#endif
+    }
+
+private:
+    // beginning of the window being scanned
+    const char* window;
+    // end of the input to scan
+    const char* end;
+    // separators in the window not yet returned
+    std::uint64_t separators{};
+    // is the end of the current window inside a quoted field?
+    bool quoted{};
+    // classification routine in use
+    classifier classify;
+
+    // bit i is set if the byte i follows an odd number of quotes
+    static std::uint64_t prefix_xor(std::uint64_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    // classify the window beginning at w
+    void load(const char* w) {
+        window = w;
+        masks m;
+        if (std::size_t(end - w) >= WINDOW) {
+            m = classify(w);
+        } else {
+            // do not read after the end of the input: pad a copy
+            // of the tail with non structural chars
+            char tail[WINDOW];
+            std::memset(tail, ' ', WINDOW);
+            std::memcpy(tail, w, end - w);
+            m = classify(tail);
+        }
+        const std::uint64_t inside = prefix_xor(m.quotes) ^ (quoted ? ~std::uint64_t() : 0);
+        quoted = inside >> 63;
+        separators = m.separators & ~inside;
+    }
+
+public:
+    // scan [begin, end), begin must not be inside a quoted field
+    csv_scanner(const char* begin, const char* end, classifier classify = best_classifier())
+    : end{end}, classify{classify}
+    {
+        load(begin);
+    }
+
+    // return the first separator outside quotes at or after p, or
+    // end if there are no more; p must not precede the position
+    // passed in the previous call
+    const char* next(const char* p) {
+        for (;;) {
+            std::uint64_t m = separators;
+            if (p > window) {
+                // ignore separators preceding p
+                m &= std::size_t(p - window) < WINDOW ? ~std::uint64_t() << (p - window) : 0;
+            }
+            if (m) {
+                return window + __builtin_ctzll(m);
+            }
+            if (window + WINDOW >= end) {
+                return end;
+            }
+            load(window + WINDOW);
+        }
+    }
+
+    // after next() returned end: true if the input ends
+    // inside a quoted field
+    bool unterminated() const {
+        return quoted;
+    }
+};
+
+
+#endif
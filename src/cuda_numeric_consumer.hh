@@ -15,9 +15,15 @@
 
 #include <vector>
 #include <valarray>
+#include <chrono>
 #include <algorithm>
+#include <stdexcept>
 
 #include "chunk.hh"
+#include "chunk_pool.hh"
+#include "chunk_tuning.hh"
+#include "chunk_split.hh"
+#include "column_pairs.hh"
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
 #include "../modules/CPP-math-utils/correlation.hh"
 #include "../modules/CPP-math-utils/couple.hh"
@@ -427,24 +433,45 @@ class cuda_numeric_consumer {
 
     // new chunk to analize
     std::unique_ptr<chunk<T>> new_cnk;
+    // chunks not stored with the preferred layout are copied here
+    std::unique_ptr<chunk<T>> transposed;
+    // where chunks are given back, if any
+    chunk_pool<T>* pool{};
+    // if any, told how long each chunk takes (see chunk_tuning::tuner)
+    chunk_tuning::tuner* tuner{};
+    // polled when chunk_queue_ptr is empty
+    std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> remote_queues;
+
+    // take a chunk from the own queue or else from a remote one
+    bool poll() {
+        if (chunk_queue_ptr->poll(new_cnk)) {
+            return true;
+        }
+        for (auto* queue : remote_queues) {
+            if (queue->poll(new_cnk)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
 #ifndef NO_PREALLOCATE_BUFFER
     thrust::device_vector<T> matrix;
 #endif
 
     // auxiliary function to perform computations
-    void compute() {
+    void compute(chunk<T>& cnk) {
 #ifdef BLACKHOLE
 #pragma message "BLACKHOLE: skip all computation!!!"
 #else
         // copy chunk to GPU
 #ifdef NO_PREALLOCATE_BUFFER
-        thrust::device_vector<T> matrix(new_cnk->begin(), new_cnk->end());
+        thrust::device_vector<T> matrix(cnk.begin(), cnk.end());
 #else
-        if (matrix.size() < new_cnk->size()) {
-            matrix = thrust::device_vector<T>(new_cnk->begin(), new_cnk->end());
+        if (matrix.size() < cnk.size()) {
+            matrix = thrust::device_vector<T>(cnk.begin(), cnk.end());
         } else {
-            thrust::copy(new_cnk->begin(), new_cnk->end(), matrix.begin());
+            thrust::copy(cnk.begin(), cnk.end(), matrix.begin());
         }
 #endif
 
@@ -465,10 +492,10 @@ class cuda_numeric_consumer {
             thrust::raw_pointer_cast(&results.totals[0]),
             thrust::raw_pointer_cast(&results.squared_totals[0]),
             thrust::raw_pointer_cast(&matrix[0]),
-            new_cnk->rows(),
-            new_cnk->cols(),
-            new_cnk->row_offset(),
-            new_cnk->column_offset()
+            cnk.rows(),
+            cnk.cols(),
+            cnk.row_offset(),
+            cnk.column_offset()
         );
         //  cross correlation
         colPairKernel<<<
@@ -484,13 +511,13 @@ class cuda_numeric_consumer {
         CBS>>>(
             thrust::raw_pointer_cast(&results.covariance_total[0]),
             thrust::raw_pointer_cast(&matrix[0]),
-            new_cnk->rows(),
-            new_cnk->cols(),
-            new_cnk->row_offset(),
-            new_cnk->column_offset()
+            cnk.rows(),
+            cnk.cols(),
+            cnk.row_offset(),
+            cnk.column_offset()
         );
         //  count new rows 
-        results.rows += new_cnk->rows();
+        results.rows += cnk.rows();
 #else
         // naive approach
         evaluate<<<
@@ -507,10 +534,10 @@ class cuda_numeric_consumer {
         >>>(
             thrust::raw_pointer_cast(&results.partials[0]),
             thrust::raw_pointer_cast(&matrix[0]),
-            new_cnk->rows(),
-            new_cnk->cols(),
-            new_cnk->row_offset(),
-            new_cnk->column_offset()
+            cnk.rows(),
+            cnk.cols(),
+            cnk.row_offset(),
+            cnk.column_offset()
         );
 #endif
 #endif  // BLACKHOLE
@@ -534,15 +561,80 @@ public:
       results(col_count)
     {}
 
+    // only all the pairs of columns are supported
+    cuda_numeric_consumer(const column_pairs& pairs,
+        std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr
+    )
+    : cuda_numeric_consumer(pairs.cols(), std::move(chunk_queue_smart_ptr))
+    {
+        if (pairs.rectangular()) {
+            throw std::invalid_argument("Rectangles of pairs are not supported on GPU");
+        }
+    }
+
+    cuda_numeric_consumer(const column_pairs& pairs,
+        lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr
+    )
+    : cuda_numeric_consumer(pairs.cols(), chunk_queue_ptr)
+    {
+        if (pairs.rectangular()) {
+            throw std::invalid_argument("Rectangles of pairs are not supported on GPU");
+        }
+    }
+
+    // layout of the chunks analysed, the others are transposed
+    // before being copied to the GPU
+    chunk_layout preferred_layout() const {
+#ifdef STORE_BY_ROWS
+#pragma message "Analyse chunks by rows..."
+        return chunk_layout::by_rows;
+#else
+#pragma message "Analyse chunks by columns..."
+        return chunk_layout::by_columns;
+#endif
+    }
+
+    // give back analysed chunks to pool instead of deleting them
+    void set_chunk_pool(chunk_pool<T>* pool) {
+        this->pool = pool;
+    }
+
+    // report analysis times to tuner
+    void set_tuner(chunk_tuning::tuner* tuner) {
+        this->tuner = tuner;
+    }
+
+    // queues to steal chunks from when the own one is empty
+    // (see numeric_consumer::set_remote_queues())
+    void set_remote_queues(std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> remote_queues) {
+        this->remote_queues = std::move(remote_queues);
+    }
+
+    // chunks are already split among the threads of the GPU
+    void set_split_board(chunk_split::board<T>*) {}
+
+    // partial results live in device memory, nothing to move
+    void reallocate() {}
+
     // try to extract a single chunk and process it
     // return true if a chunk is found, false otherwise
     bool analyze() {
         // try to extract a new chunk to analize
-        if (!chunk_queue_ptr->poll(new_cnk)) {
+        if (!poll()) {
+            if (tuner) {
+                tuner->queue_empty();
+            }
             return false;
         }
-        compute();
-        new_cnk.release();
+        if (tuner) {
+            const auto start = std::chrono::steady_clock::now();
+            compute(with_layout(*new_cnk, preferred_layout(), transposed));
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            tuner->chunk_analysed(new_cnk->max_rows(), std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        } else {
+            compute(with_layout(*new_cnk, preferred_layout(), transposed));
+        }
+        recycle_chunk(pool, new_cnk);
         return true;
     }
 
@@ -0,0 +1,414 @@
+
+#ifndef DECOMPRESSOR
+#define DECOMPRESSOR
+
+#include <memory>
+#include <string>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+#include "async_input.hh"
+
+#ifdef ZLIB
+#pragma message "Accept gzip compressed input..."
+#include <zlib.h>
+#endif
+
+#ifdef ZSTD
+#pragma message "Accept zstd compressed input..."
+#include <deque>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <zstd.h>
+#include "mapped_file.hh"
+#endif
+
+/**
+ * Compressed inputs (.csv.gz, .csv.zst) are decompressed by a
+ * dedicated thread running ahead of the tokenizer: decompressed data
+ * is handed over in blocks through a pair of queues, so that while a
+ * block is being read by the reader the next one is being filled
+ * (double buffering). The reader sees a plain std::istream.
+ *
+ * gzip requires compiling with ZLIB (and linking with -lz), zstd
+ * with ZSTD (-lzstd). The format is detected from the magic number.
+ */
+namespace compression {
+
+    enum class format {
+        none, gzip, zstd
+    };
+
+    // detect compression from the beginning of the file
+    inline format detect(const std::string& filename) {
+        unsigned char magic[4]{};
+        std::ifstream file(filename, std::ios::binary);
+        file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+        if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+            return format::gzip;
+        }
+        if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+            return format::zstd;
+        }
+        return format::none;
+    }
+
+    inline bool is_compressed(const std::string& filename) {
+        return detect(filename) != format::none;
+    }
+
+    // produce decompressed data
+    class source {
+    public:
+        virtual ~source() = default;
+        // fill at most size bytes of out, return how many have
+        // been written: 0 means end of input
+        virtual std::size_t read(char* out, std::size_t size) = 0;
+    };
+
+#ifdef ZLIB
+    // gzip (or zlib) streams, possibly made of many members
+    // as the ones produced by pigz or bgzip
+    class gzip_source : public source {
+        static constexpr std::size_t BUFFER_SIZE = 1 << 16;
+
+        std::string filename;
+        std::ifstream input;
+        // compressed data read from input
+        std::unique_ptr<char[]> buffer;
+        z_stream stream{};
+        // is a member being decompressed?
+        bool inside{};
+
+        [[noreturn]] void fail(const char* what) const {
+            using namespace std::literals;
+            throw std::runtime_error(what + " "s + filename + (stream.msg ? ": "s + stream.msg : ""s));
+        }
+
+    public:
+        gzip_source(std::string filename)
+        : filename{std::move(filename)}, input(this->filename, std::ios::binary), buffer{new char[BUFFER_SIZE]}
+        {
+            if (!input) {
+                using namespace std::literals;
+                throw std::system_error(errno, std::generic_category(), "Cannot open "s + this->filename);
+            }
+            // 15 bits window, +32 to detect gzip or zlib header
+            if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+                fail("Cannot decompress");
+            }
+        }
+
+        ~gzip_source() {
+            inflateEnd(&stream);
+        }
+
+        std::size_t read(char* out, std::size_t size) override {
+            stream.next_out = reinterpret_cast<Bytef*>(out);
+            stream.avail_out = size;
+            while (stream.avail_out) {
+                if (stream.avail_in == 0) {
+                    input.read(buffer.get(), BUFFER_SIZE);
+                    stream.next_in = reinterpret_cast<Bytef*>(buffer.get());
+                    stream.avail_in = input.gcount();
+                    if (stream.avail_in == 0) {
+                        if (inside) {
+                            fail("Truncated gzip input");
+                        }
+                        break;
+                    }
+                }
+                inside = true;
+                const int ret = inflate(&stream, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END) {
+                    // another member may follow
+                    inside = false;
+                    inflateReset(&stream);
+                } else if (ret != Z_OK) {
+                    fail("Corrupted gzip input");
+                }
+            }
+            return size - stream.avail_out;
+        }
+    };
+#endif
+
+#ifdef ZSTD
+    // zstd streams: independent frames (e.g. produced by
+    // zstd -T or pzstd) are decompressed in parallel, frames
+    // too big to be kept in memory are decompressed as a stream
+    class zstd_source : public source {
+        // frames bigger than this are not decompressed ahead
+        static constexpr std::size_t MAX_PARALLEL_FRAME = 1 << 26;
+
+        // compressed frames are located in place
+        mapped_file input;
+        // beginning of the first frame not yet scheduled
+        const char* next_frame;
+        // frames scheduled, in input order
+        struct frame_job {
+            const char* begin;
+            std::size_t size;
+            // decompressed by a separate thread, if valid
+            std::future<std::vector<char>> content;
+        };
+        std::deque<frame_job> pending;
+        // frames decompressed concurrently
+        const std::size_t parallelism;
+        // decompressed frame being read
+        std::vector<char> frame;
+        std::size_t frame_pos{};
+        // frame decompressed as a stream, if any
+        ZSTD_DCtx* context;
+        ZSTD_inBuffer streamed{};
+        bool streaming{};
+
+        static void check(std::size_t ret) {
+            if (ZSTD_isError(ret)) {
+                using namespace std::literals;
+                throw std::runtime_error("Corrupted zstd input: "s + ZSTD_getErrorName(ret));
+            }
+        }
+
+        static std::vector<char> decompress_frame(const char* begin, std::size_t size, std::size_t content_size) {
+            std::vector<char> ans(content_size);
+            const auto ret = ZSTD_decompress(ans.data(), ans.size(), begin, size);
+            check(ret);
+            ans.resize(ret);
+            return ans;
+        }
+
+        // schedule frames until enough are being decompressed
+        void schedule() {
+            while (pending.size() < parallelism && next_frame != input.end()) {
+                const std::size_t size = ZSTD_findFrameCompressedSize(next_frame, input.end() - next_frame);
+                check(size);
+                frame_job job{next_frame, size, {}};
+                const auto content_size = ZSTD_getFrameContentSize(next_frame, size);
+                if (content_size <= MAX_PARALLEL_FRAME) {
+                    job.content = std::async(std::launch::async, decompress_frame, next_frame, size, std::size_t(content_size));
+                }
+                pending.push_back(std::move(job));
+                next_frame += size;
+            }
+        }
+
+    public:
+        zstd_source(std::string filename)
+        : input(std::move(filename)), next_frame{input.begin()},
+          parallelism{std::max(1u, std::thread::hardware_concurrency())},
+          context{ZSTD_createDCtx()}
+        {
+            if (!context) {
+                throw std::bad_alloc();
+            }
+        }
+
+        ~zstd_source() {
+            // wait for frames still being decompressed
+            pending.clear();
+            ZSTD_freeDCtx(context);
+        }
+
+        std::size_t read(char* out, std::size_t size) override {
+            std::size_t written{};
+            while (written != size) {
+                if (frame_pos != frame.size()) {
+                    const auto n = std::min(size - written, frame.size() - frame_pos);
+                    std::memcpy(out + written, frame.data() + frame_pos, n);
+                    frame_pos += n;
+                    written += n;
+                } else if (streaming) {
+                    ZSTD_outBuffer output{out + written, size - written, 0};
+                    const auto ret = ZSTD_decompressStream(context, &output, &streamed);
+                    check(ret);
+                    written += output.pos;
+                    if (ret == 0) {
+                        streaming = false;
+                    } else if (streamed.pos == streamed.size && output.pos == 0) {
+                        throw std::runtime_error("Truncated zstd input");
+                    }
+                } else {
+                    schedule();
+                    if (pending.empty()) {
+                        break;
+                    }
+                    auto job = std::move(pending.front());
+                    pending.pop_front();
+                    if (job.content.valid()) {
+                        frame = job.content.get();
+                        frame_pos = 0;
+                    } else {
+                        ZSTD_DCtx_reset(context, ZSTD_reset_session_only);
+                        streamed = ZSTD_inBuffer{job.begin, job.size, 0};
+                        streaming = true;
+                    }
+                    // keep decompressing ahead
+                    schedule();
+                }
+            }
+            return written;
+        }
+    };
+#endif
+
+    // stream buffer whose content is produced by a separate thread
+    // decompressing the input block by block
+    class decompressing_streambuf : public std::streambuf {
+    public:
+        // bytes in each block
+        static constexpr std::size_t BLOCK_BYTES = 1 << 20;
+        // one block is read while the other is filled
+        static constexpr std::size_t BLOCKS = 2;
+
+    private:
+        struct block {
+            std::unique_ptr<char[]> data{new char[BLOCK_BYTES]};
+            std::size_t size{};
+        };
+
+        std::unique_ptr<source> input;
+        // blocks to be filled and filled blocks
+        lockfree_queue::fixed_size_lockfree_queue<block> empty_blocks{BLOCKS};
+        lockfree_queue::fixed_size_lockfree_queue<block> full_blocks{BLOCKS};
+        // block being read
+        std::unique_ptr<block> current;
+        // decompression stage
+        std::thread stage;
+        // no more blocks will be filled
+        std::atomic_bool done{};
+        // reader is gone
+        std::atomic_bool stop{};
+        // error occurred while decompressing, valid once done is set
+        std::exception_ptr failure;
+
+        void run() {
+            try {
+                std::unique_ptr<block> b;
+                while (!stop.load()) {
+                    if (!b && !empty_blocks.poll(b)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    if (!b->size) {
+                        b->size = input->read(b->data.get(), BLOCK_BYTES);
+                        if (!b->size) {
+                            break;
+                        }
+                    }
+                    if (!full_blocks.offer(b)) {
+                        std::this_thread::yield();
+                    }
+                }
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            done.store(true);
+        }
+
+        // take the next filled block, return false at end of input
+        bool next_block() {
+            for (;;) {
+                // check done before polling: blocks are all
+                // enqueued before it is set
+                const bool last = done.load();
+                if (full_blocks.poll(current)) {
+                    return true;
+                }
+                if (last) {
+                    if (failure) {
+                        std::rethrow_exception(failure);
+                    }
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) {
+                return traits_type::to_int_type(*gptr());
+            }
+            if (current) {
+                // give the block back to be filled again, it
+                // cannot fail: there are only BLOCKS blocks
+                current->size = 0;
+                empty_blocks.offer(current);
+            }
+            if (!next_block()) {
+                return traits_type::eof();
+            }
+            setg(current->data.get(), current->data.get(), current->data.get() + current->size);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        decompressing_streambuf(std::unique_ptr<source> input)
+        : input{std::move(input)}
+        {
+            for (std::size_t i{}; i != BLOCKS; ++i) {
+                auto b = std::make_unique<block>();
+                empty_blocks.offer(b);
+            }
+            stage = std::thread([this](){ run(); });
+        }
+
+        ~decompressing_streambuf() {
+            stop.store(true);
+            stage.join();
+        }
+
+        decompressing_streambuf(const decompressing_streambuf&) = delete;
+        decompressing_streambuf& operator=(const decompressing_streambuf&) = delete;
+    };
+
+    // input stream reading a decompressed file, decompression errors
+    // are reported as exceptions
+    class decompressing_istream : public std::istream {
+        decompressing_streambuf buffer;
+
+    public:
+        decompressing_istream(std::unique_ptr<source> input)
+        : std::istream(nullptr), buffer(std::move(input))
+        {
+            rdbuf(&buffer);
+            exceptions(std::ios::badbit);
+        }
+    };
+
+    // open the given file as a stream of decompressed data, if the
+    // file is not compressed it is read as is (see async_input.hh)
+    inline std::unique_ptr<std::istream> open(const std::string& filename, const async_io::options& io = {}) {
+        using namespace std::literals;
+        switch (detect(filename)) {
+        case format::gzip:
+#ifdef ZLIB
+            return std::make_unique<decompressing_istream>(std::make_unique<gzip_source>(filename));
+#else
+            throw std::runtime_error("Compile with ZLIB to read gzip compressed file "s + filename);
+#endif
+        case format::zstd:
+#ifdef ZSTD
+            return std::make_unique<decompressing_istream>(std::make_unique<zstd_source>(filename));
+#else
+            throw std::runtime_error("Compile with ZSTD to read zstd compressed file "s + filename);
+#endif
+        default:
+            return async_io::open(filename, io);
+        }
+    }
+}
+
+
+#endif
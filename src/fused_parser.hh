@@ -0,0 +1,178 @@
+
+#ifndef FUSED_PARSER
+#define FUSED_PARSER
+
+#include <memory>
+#include <string_view>
+#include <stdexcept>
+
+#include "chunk.hh"
+#include "chunk_pool.hh"
+#include "chunk_tuning.hh"
+#include "mmap_reader.hh"
+#include "numeric_parser.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+
+// Like numeric_parser, but rows are not taken from a queue:
+// they are tokenized directly from the byte range of an
+// mmap_reader and each field is converted and stored in the
+// chunk as soon as it is found.
+template <typename T>
+class fused_parser {
+    // how many rows in each chunk
+    std::size_t rows_per_chunk = numeric_parser<T>::DEFAULT_ROW_NUMBER;
+
+    // INPUT: byte range to parse, not owned
+    mmap_reader* input{};
+    // no more rows in input (or no input at all)
+    bool exhausted{true};
+
+    // chunk to fill
+    std::unique_ptr<chunk<T>> curr_cnk;
+    // where chunks are taken from, if any
+    chunk_pool<T>* pool{};
+    // if any, decides the rows of new chunks instead of rows_per_chunk
+    chunk_tuning::tuner* tuner{};
+    // chunk filled? If true try to insert it into output queue
+    bool chunk_filled {};
+
+    // number of item in each row
+    const std::size_t row_length;
+
+// OUTPUT queue: chunk queues to store parsed data
+    // used to support smart memory management
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr;
+    // the queue will be accessed by a row pointer allowing
+    // this class to receive both smart and raw pointers
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr;
+
+public:
+    fused_parser(
+        std::size_t row_length,
+        std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr
+    )
+    : row_length{row_length},
+      chunk_queue_smart_ptr{std::move(chunk_queue_smart_ptr)},
+      chunk_queue_ptr{this->chunk_queue_smart_ptr.get()}
+    {}
+
+    fused_parser(
+        std::size_t row_length,
+        lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr
+    )
+    : row_length{row_length},
+      chunk_queue_ptr{chunk_queue_ptr}
+    {}
+
+    void set_rows_per_chunk(std::size_t rows_per_chunk) {
+        // cannot change chunk size after parsing has been started
+        if (curr_cnk) {
+            throw std::logic_error("Cannot change chunk size (rows) after parsing has been started.");
+        }
+        this->rows_per_chunk = rows_per_chunk;
+    }
+
+    // take chunks from pool instead of allocating them
+    void set_chunk_pool(chunk_pool<T>* pool) {
+        this->pool = pool;
+    }
+
+    // let tuner choose the rows of each chunk
+    void set_tuner(chunk_tuning::tuner* tuner) {
+        this->tuner = tuner;
+    }
+
+    // set the byte range to be parsed
+    void set_input(mmap_reader* input) {
+        this->input = input;
+        exhausted = input == nullptr;
+    }
+
+    // tokenize and convert rows from the input until a chunk is
+    // filled, then store it into OUTPUT queue
+    // return true if a chunk as been successfully
+    // stored, false otherwise
+    bool parse_chunk() {
+        // was previously filled chunk transferred into OUTPUT queue
+        if (chunk_filled) {
+            // try to store filled chunk
+            if (chunk_queue_ptr->offer(curr_cnk)) {
+                chunk_filled = false;
+                return true;
+            }
+            // attempt failed, will retry later
+            return false;
+        }
+        if (exhausted) {
+            return false;
+        }
+        if (!curr_cnk) {
+            curr_cnk = acquire_chunk(pool, tuner ? tuner->rows() : rows_per_chunk, row_length);
+            if (!curr_cnk) {
+                // memory budget exhausted, retry later
+                return false;
+            }
+        }
+        chunk<T>& cnk = *curr_cnk;
+        // fill the chunk with new rows
+        while (!cnk.full()) {
+            const bool found = input->consume_row([&cnk](std::string_view field){
+                cnk.unsafe_push_back(field_to_number<T>(field));
+            });
+            if (!found) {
+                exhausted = true;
+                return false;
+            }
+        }
+        // try to insert
+        if (!chunk_queue_ptr->offer(curr_cnk)) {
+            // failed, defer insertion
+            chunk_filled = true;
+            return false;
+        }
+        // success!
+        return true;
+    }
+
+    // continously parse chunk until failure
+    void parse_many() {
+        while (parse_chunk());
+    }
+
+    // try to load partially filled chunk (if available, otherwise
+    // immediately return true)
+    bool store_partial_chunk() {
+        if (!curr_cnk || curr_cnk->empty()) {
+            return true;
+        } else {
+            // mark current chunk as filled (ready to be stored)
+            chunk_filled = true;
+            // try to store chunk
+            if (chunk_queue_ptr->offer(curr_cnk)) {
+                chunk_filled = false;
+                return true;
+            }
+            // attempt failed, will retry later
+            return false;
+        }
+    }
+
+    // return true if the whole input has been parsed
+    bool input_exhausted() const {
+        return exhausted;
+    }
+
+    // return true if a chunk is hold now
+    bool hold() const {
+        return curr_cnk.get() != nullptr;
+    }
+
+    // return true if it is waiting to store a new chunk
+    bool hold_filled() const {
+        return chunk_filled;
+    }
+};
+
+
+#endif
@@ -8,6 +8,15 @@
 #include "queues.hh"
 #include "worker.hh"
 #include "reader.hh"
+#include "mmap_reader.hh"
+#include "binary_format.hh"
+#include "binary_reader.hh"
+#include "column_selection.hh"
+#include "column_pairs.hh"
+#include "topology.hh"
+#include "chunk_tuning.hh"
+#include "pcc_kernels.hh"
+#include "controller.hh"
 
 
 #ifdef GPU
@@ -37,12 +46,28 @@ try
 #pragma message "Compiling code to use CPU only..."
     using worker_type = worker<data_type>;
 #endif
+#ifdef MMAP
+#pragma message "Read input file through mmap..."
+    using reader_type = mmap_reader;
+#else
+#pragma message "Read input file through std::ifstream..."
+    using reader_type = reader;
+#endif
 
     // nWorkers-1 are on separated thread
     // the last is on the main thread
 
     auto parsed = parse(argc, argv);
 
+    // store the input as a binary file to skip parsing in future runs
+    if (parsed.convert) {
+        binary_format::convert<data_type>(parsed.input_file, parsed.output_file, parsed.columns);
+        return 0;
+    }
+
+    // binary files need no parsing: their chunks are read directly
+    const bool binary_input = binary_format::is_binary(parsed.input_file);
+
     const unsigned int nWorkers = 1 + parsed.worker_count;
 
     // generate queues
@@ -50,39 +75,257 @@ try
         new queues<data_type>(nWorkers)
     );
 
+    // a chunk queue per node, workers are assigned to nodes in turn
+    if (parsed.numa) {
+        data_queues->set_numa_nodes(topology::nodes());
+    }
+
+    // a CPU per worker, the main thread may have a core on its own
+    if (parsed.pin) {
+        auto cpus = topology::cpus();
+        if (!parsed.cpus.empty()) {
+            const auto allowed = topology::parse_cpu_list(parsed.cpus);
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&](const topology::cpu& c){
+                return std::find(allowed.begin(), allowed.end(), c.id) == allowed.end();
+            }), cpus.end());
+            if (cpus.empty()) {
+                throw parsing_exception("No online CPU in --cpus " + parsed.cpus);
+            }
+        }
+        const auto smt = parsed.smt == "pack" ? topology::smt::pack : topology::smt::avoid;
+        auto order = topology::placement_order(cpus, smt);
+        if (parsed.isolate_main) {
+            // workers avoid all the CPUs of the core of the main thread
+            auto others = topology::placement_order(topology::without_core_of(cpus, order.front()), smt);
+            if (!others.empty()) {
+                others.insert(others.begin(), order.front());
+                order = std::move(others);
+            }
+        }
+        data_queues->pin_workers(order, parsed.isolate_main && order.size() > 1);
+    }
+
+    // how workers wait when they find nothing to do
+    waiting::options wait;
+    if (parsed.wait == "spin") {
+        wait.policy = waiting::strategy::spin;
+    } else if (parsed.wait == "yield") {
+        wait.policy = waiting::strategy::yield;
+    } else if (parsed.wait == "park") {
+        wait.policy = waiting::strategy::park;
+    }
+    if (parsed.spins) {
+        wait.spins = parsed.spins;
+    }
+    data_queues->set_wait_options(wait);
+
+    // bound the rows waiting and the chunks alive, before
+    // readers are created
+    if (parsed.max_memory) {
+        data_queues->set_max_memory(parsed.max_memory);
+    }
+
     // if specified in argv, set rows per chunk
     if (parsed.row_count) {
         data_queues->set_rows_per_chunk(parsed.row_count);
     }
 
+#ifndef MMAP
+    if (parsed.fused) {
+        throw parsing_exception("--fused is available only when compiled with MMAP");
+    }
+#endif
+
+    // separate pools of parsers and analysers, binary files need
+    // no parsers
+    if (parsed.roles && !binary_input) {
+        if (parsed.fused) {
+            throw parsing_exception("--roles cannot be used with --fused");
+        }
+        if (nWorkers < 3) {
+            throw parsing_exception("--roles needs at least 2 workers");
+        }
+        data_queues->set_stage_roles();
+    }
+
+    // tiles of the pairs of large chunks analysed by several
+    // workers, the rectangle is not split
+    if (parsed.split) {
+#if defined(GPU) || defined(SLOW) || defined(BLACKHOLE)
+        throw parsing_exception("--split is not available when compiled with GPU, SLOW or BLACKHOLE");
+#endif
+        if (!parsed.against.empty()) {
+            throw parsing_exception("--split cannot be used with --against");
+        }
+        data_queues->set_split(parsed.split);
+    }
+
+    // how CSV files are read when they are not mapped: with MMAP
+    // they are, or they are compressed and read by the decompressor
+#ifdef MMAP
+    if (parsed.io_depth || parsed.io_block || parsed.direct) {
+        throw parsing_exception("--io-depth, --io-block and --direct are not available when compiled with MMAP");
+    }
+#endif
+    async_io::options io;
+    if (parsed.io_depth) {
+        io.queue_depth = parsed.io_depth;
+    }
+    if (parsed.io_block) {
+        io.block_size = parsed.io_block;
+    }
+    io.direct = parsed.direct;
+
     // generate reader - necessary to get column count
-    reader r(parsed.input_file, data_queues->rowQueue);
+    std::unique_ptr<binary_reader<data_type>> br;
+    std::unique_ptr<reader_type> r;
+    // compressed files cannot be mapped: with MMAP they are
+    // read as a stream by the main thread
+    std::unique_ptr<reader> sr;
+    if (binary_input) {
+        br.reset(new binary_reader<data_type>(parsed.input_file, data_queues->chunkQueue));
+        br->set_chunk_pool(data_queues->chunkPool.get());
+        if (parsed.row_count) {
+            br->set_rows_per_chunk(parsed.row_count);
+        }
+#ifdef MMAP
+    } else if (compression::is_compressed(parsed.input_file)) {
+        sr.reset(new reader(parsed.input_file, data_queues->rowQueue));
+#endif
+    } else {
+#ifdef MMAP
+        r.reset(new reader_type(parsed.input_file, data_queues->rowQueue));
+#else
+        r.reset(new reader_type(parsed.input_file, data_queues->rowQueue, io));
+#endif
+    }
+
+    // analyse only the selected columns, readers skip the others
+    column_selection selection(br ? br->column_count() : r ? r->column_count() : sr->column_count());
+    // columns of chunks to be paired on each side, if not all
+    // the pairs are needed
+    std::vector<std::size_t> side_a, side_b;
+    if (!parsed.columns.empty() || !parsed.against.empty()) {
+        // binary files have no column names
+        const auto names = binary_input ? std::vector<std::string>{} : read_header(parsed.input_file);
+        if (!parsed.columns.empty()) {
+            selection = parse_columns(parsed.columns, selection.total(), names);
+        }
+        if (!parsed.against.empty()) {
+            const auto a = selection;
+            const auto b = parse_columns(parsed.against, selection.total(), names);
+            // chunks hold both sides
+            selection = a | b;
+            side_a = selection.positions(a);
+            side_b = selection.positions(b);
+        }
+        if (br) {
+            br->select_columns(selection);
+        } else if (r) {
+            r->select_columns(selection);
+        } else if (sr) {
+            sr->select_columns(selection);
+        }
+    }
 
     // get column count from the input file
-    const auto column_count = r.column_count();
+    const auto column_count = selection.size();
+
+    // rows per chunk depend on the columns
+    bool rows_changed{};
+    if (parsed.auto_rows) {
+        data_queues->set_rows_per_chunk(chunk_tuning::rows_for<data_type>(column_count, topology::caches()));
+        rows_changed = true;
+    }
+    // and on the memory budget, if any
+    if (data_queues->budget && data_queues->fit_rows_per_chunk(column_count, numeric_parser<data_type>::DEFAULT_ROW_NUMBER)) {
+        rows_changed = true;
+    }
+    if (rows_changed && br) {
+        br->set_rows_per_chunk(data_queues->rows_per_chunk);
+    }
+    if (parsed.adaptive_rows) {
+        data_queues->set_adaptive_rows();
+    }
+    const auto pairs = side_a.empty() ? column_pairs(column_count) : column_pairs(column_count, side_a, side_b);
+#ifdef GPU
+    if (pairs.rectangular()) {
+        throw parsing_exception("--against is not available when compiled with GPU");
+    }
+#endif
     //const auto result_count = worker<data_type>::result_size_from_column_count(column_count);
     // will hold result type
 
+#ifdef MMAP
+    // split input in byte ranges, one per worker or, with
+    // pools of parsers and analysers, a single one for the
+    // main thread
+    std::vector<std::unique_ptr<mmap_reader>> ranges;
+    if (r) {
+        const unsigned int readers = data_queues->roles ? 1 : nWorkers;
+        ranges = r->split(readers);
+        data_queues->set_reader_count(readers);
+        // tokenize and convert input in a single step?
+        data_queues->set_fused(parsed.fused);
+    }
+#endif
+
     // spawn workers
     std::vector<std::unique_ptr<worker_type>> workers; workers.reserve(nWorkers);
     for (std::size_t _{1}; _!=nWorkers; ++_) {
-        workers.emplace_back(new worker_type(column_count, data_queues));
+        workers.emplace_back(new worker_type(pairs, data_queues, _));
+#ifdef MMAP
+        if (r && _ < ranges.size()) {
+            workers.back()->set_input(std::move(ranges[_]));
+        }
+#endif
         workers.back()->spawn_and_run();
     }
 
+    // move workers between pools while parsing
+    std::unique_ptr<controller<data_type>> balancer;
+    if (data_queues->roles) {
+        balancer = std::make_unique<controller<data_type>>(data_queues);
+        balancer->start();
+    }
+
     // generate worker executing while IO stalls
-    worker_type main_worker(column_count, data_queues);
+    worker_type main_worker(pairs, data_queues, 0);
+    main_worker.move_to_node();
 
     // read input untill it ends
-    while (!r.consume_many()) {
-        // IO stalls, perform some computations on
-        // main thread
-        main_worker.perform_iteration();
+    auto read_all = [&](auto& input) {
+        while (!input.consume_many()) {
+            // new rows (or chunks) for the parked workers
+            data_queues->notify();
+            // IO stalls, perform some computations on
+            // main thread
+            if (!main_worker.perform_iteration()) {
+                // some worker failed, join() will report it
+                break;
+            }
+        }
+        // END OF INPUT REACHED!
+        data_queues->set_end_of_input();
+    };
+
+    if (br) {
+        read_all(*br);
+    } else if (sr) {
+        read_all(*sr);
+    } else {
+#ifdef MMAP
+        // main thread reads its range like any other worker
+        main_worker.set_input(std::move(ranges[0]));
+#else
+        read_all(*r);
+#endif
     }
-    // END OF INPUT REACHED!
-    data_queues->set_end_of_input();
     // finish computations on main thread
-    while (main_worker.perform_iteration());
+    while (main_worker.wait_and_iterate());
+    if (balancer) {
+        balancer->stop();
+    }
     
     // accumulate results:
     // initially from main thread
@@ -95,6 +338,21 @@ try
         results += w->get_results_and_invalidate();
     }
 
+    // how much workers contended for the chunks
+    if (parsed.stats) {
+        const auto stats = data_queues->deque_stats();
+        std::cerr << "deque locks: " << stats.locks << ", contended: " << stats.contended
+                  << ", steals: " << stats.steals << ", chunks stolen: " << stats.stolen
+                  << ", kernels: " << pcc_kernels::best<data_type>().name;
+        if (balancer) {
+            std::cerr << ", workers moved: " << balancer->moves();
+        }
+        if (data_queues->budget) {
+            std::cerr << ", peak bytes of chunks: " << data_queues->budget->peak() << " of " << data_queues->budget->capacity();
+        }
+        std::cerr << '\n';
+    }
+
     auto resSize = results.size();
     std::valarray<data_type> analysed(resSize);
     for (std::size_t _{}; _!=resSize; ++_) {
@@ -102,9 +360,17 @@ try
     }
 
     std::size_t couple_idx {};
-    for (std::size_t c1{}; c1 != column_count; ++c1) {
+    // pairs of the rectangle, if any
+    for (const auto c1 : pairs.a()) {
+        for (const auto c2 : pairs.b()) {
+            std::cout << '(' << selection.column(c1) << ',' << selection.column(c2) << ") " << analysed[couple_idx++] << '\n';
+        }
+    }
+    // all the pairs otherwise
+    for (std::size_t c1{}; c1 != column_count && !pairs.rectangular(); ++c1) {
         for (std::size_t c2{c1+1}; c2 != column_count; ++c2) {
-            std::cout << '(' << c1 << ',' << c2 << ") " << analysed[couple_idx++] << '\n';
+            // refer to columns of the input
+            std::cout << '(' << selection.column(c1) << ',' << selection.column(c2) << ") " << analysed[couple_idx++] << '\n';
         }
     }
 
@@ -0,0 +1,154 @@
+
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <string>
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief RAII wrapper around a read only memory mapping of a whole
+ * file. The content of the file can be accessed as a sequence of
+ * chars without copying it in user space buffers.
+ */
+class mapped_file {
+    // name of the mapped file
+    std::string filename;
+    // beginning of the mapping, nullptr for empty files
+    const char* _data{};
+    // size in bytes of the mapping
+    std::size_t _size{};
+
+    [[noreturn]] void fail(const char* what) const {
+        using namespace std::literals;
+        throw std::system_error(errno, std::generic_category(), what + " "s + filename);
+    }
+
+public:
+    mapped_file(std::string filename)
+    : filename{std::move(filename)}
+    {
+        int fd = ::open(this->filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            fail("Cannot open");
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            ::close(fd);
+            fail("Cannot stat");
+        }
+        _size = st.st_size;
+        // mmap does not accept zero length mappings
+        if (_size) {
+            void* ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                fail("Cannot mmap");
+            }
+            _data = static_cast<const char*>(ptr);
+            // input is expected to be read once from the beginning
+            // to the end, let the kernel read ahead aggressively
+            ::madvise(ptr, _size, MADV_SEQUENTIAL);
+        }
+        // the mapping remains valid after closing the descriptor
+        ::close(fd);
+    }
+
+    ~mapped_file() {
+        if (_data) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+    }
+
+    // prevent copying, the mapping has a single owner
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    const char* data() const {
+        return _data;
+    }
+
+    const char* begin() const {
+        return _data;
+    }
+
+    const char* end() const {
+        return _data + _size;
+    }
+};
+
+/**
+ * @brief RAII wrapper around a writable shared memory mapping of
+ * a file created (or truncated) with the given size: data written
+ * into the mapping is stored in the file.
+ */
+class mapped_output_file {
+    // name of the mapped file
+    std::string filename;
+    // beginning of the mapping, nullptr for empty files
+    char* _data{};
+    // size in bytes of the mapping
+    std::size_t _size{};
+
+    [[noreturn]] void fail(const char* what) const {
+        using namespace std::literals;
+        throw std::system_error(errno, std::generic_category(), what + " "s + filename);
+    }
+
+public:
+    mapped_output_file(std::string filename, std::size_t size)
+    : filename{std::move(filename)}, _size{size}
+    {
+        int fd = ::open(this->filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            fail("Cannot create");
+        }
+        if (::ftruncate(fd, _size) == -1) {
+            ::close(fd);
+            fail("Cannot resize");
+        }
+        if (_size) {
+            void* ptr = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                fail("Cannot mmap");
+            }
+            _data = static_cast<char*>(ptr);
+        }
+        ::close(fd);
+    }
+
+    ~mapped_output_file() {
+        if (_data) {
+            ::munmap(_data, _size);
+        }
+    }
+
+    // prevent copying, the mapping has a single owner
+    mapped_output_file(const mapped_output_file&) = delete;
+    mapped_output_file& operator=(const mapped_output_file&) = delete;
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    char* data() {
+        return _data;
+    }
+};
+
+
+#endif
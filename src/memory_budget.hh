@@ -0,0 +1,70 @@
+
+#ifndef MEMORY_BUDGET
+#define MEMORY_BUDGET
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bytes that can be allocated by the buffers of the pipeline
+ * (--max-memory): chunk pools ask for the bytes of each new chunk and
+ * give them back when the chunk is deleted, threads that cannot
+ * allocate wait for other chunks to be recycled (back-pressure).
+ *
+ * The first allocation always succeeds, so the pipeline progresses
+ * even if a single chunk exceeds the budget.
+ */
+class memory_budget {
+    const std::size_t limit;
+    std::atomic_size_t used{};
+    std::atomic_size_t _peak{};
+    // some allocation failed since the last release, pools
+    // should free the chunks they keep
+    std::atomic_bool _pressure{};
+
+public:
+    memory_budget(std::size_t limit)
+    : limit{limit}
+    {}
+
+    memory_budget(const memory_budget&) = delete;
+    memory_budget& operator=(const memory_budget&) = delete;
+
+    // take bytes, if still available
+    bool try_acquire(std::size_t bytes) {
+        std::size_t current = used.load(std::memory_order_relaxed);
+        do {
+            if (current && current + bytes > limit) {
+                _pressure.store(true, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!used.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+        std::size_t peak = _peak.load(std::memory_order_relaxed);
+        while (peak < current + bytes && !_peak.compare_exchange_weak(peak, current + bytes, std::memory_order_relaxed));
+        return true;
+    }
+
+    void release(std::size_t bytes) {
+        used.fetch_sub(bytes, std::memory_order_relaxed);
+        _pressure.store(false, std::memory_order_relaxed);
+    }
+
+    bool pressure() const {
+        return _pressure.load(std::memory_order_relaxed);
+    }
+
+    std::size_t bytes() const {
+        return used.load(std::memory_order_relaxed);
+    }
+
+    std::size_t peak() const {
+        return _peak.load(std::memory_order_relaxed);
+    }
+
+    std::size_t capacity() const {
+        return limit;
+    }
+};
+
+
+#endif
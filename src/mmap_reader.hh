@@ -0,0 +1,299 @@
+
+#ifndef MMAP_READER
+#define MMAP_READER
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <stdexcept>
+
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+#include "mapped_file.hh"
+#include "row_block.hh"
+#include "csv_scanner.hh"
+#include "column_selection.hh"
+
+
+/**
+ * @brief Like reader, but the input file is mapped in memory and
+ * the blocks of rows put in the queue only refer to it. Blocks are
+ * valid as long as the mapping is alive, i.e. as long as any
+ * mmap_reader referring to it exists.
+ *
+ * Each mmap_reader tokenize the rows beginning in a given byte range
+ * of the file, so the input can be split (see split()) between many
+ * readers working concurrently.
+ *
+ * Columns not selected (see select_columns()) are skipped as soon as
+ * their separator is found.
+ */
+class mmap_reader {
+public:
+    class end_of_inputs : public std::exception {};
+private:
+    // mapped input file, shared between all the readers
+    // obtained by split()
+    std::shared_ptr<const mapped_file> input;
+    // next char to be tokenized
+    const char* cursor;
+    // end of the byte range assigned to this reader
+    const char* end;
+    // to find separators in [cursor, end)
+    csv_scanner scanner;
+    // number of columns, obtained from the header
+    std::size_t _column_count{};
+    // columns passed on, all by default
+    column_selection selection;
+
+    // used to support smart memory management
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr;
+    // the queue will be accessed by a row pointer allowing
+    // this class to receive both smart and raw pointers
+    lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr;
+    // if data cannot be are maintained here
+    std::unique_ptr<row_block> holder;
+
+    // position in the file, used to report errors
+    std::size_t offset(const char* p) const {
+        return p - input->begin();
+    }
+
+    // extract the next field starting from cursor, the cursor is
+    // moved after the separator following the field.
+    // Return true if the field is the last of its line.
+    [[noreturn]] void unterminated(const char* begin) const {
+        using namespace std::literals;
+        auto msg = "Unterminated quoted field after byte "s + std::to_string(offset(begin));
+        if (end != input->end()) {
+            // see split()
+            msg += ": quoted new lines are not supported when input is split between many readers"s;
+        }
+        throw std::runtime_error(msg);
+    }
+
+    bool next_field(std::string_view& field) {
+        const char* begin = cursor;
+        const char* sep = scanner.next(cursor);
+        if (sep == end && scanner.unterminated()) {
+            unterminated(begin);
+        }
+        const char* last = sep;
+        // handle CRLF line terminators
+        if (last != begin && last[-1] == '\r') {
+            --last;
+        }
+        if (begin != last && *begin == '"') {
+            // quoted field: remove quotes, double
+            // quotes ("") are left untouched in the view
+            if (last - begin < 2 || last[-1] != '"') {
+                using namespace std::literals;
+                throw std::runtime_error("Malformed quoted field at byte "s + std::to_string(offset(begin)));
+            }
+            ++begin;
+            --last;
+        }
+        field = std::string_view(begin, last - begin);
+        // skip separator
+        if (sep == end) {
+            cursor = sep;
+            return true;
+        }
+        cursor = sep + 1;
+        return *sep == '\n';
+    }
+
+    // like next_field(), but the field is not extracted
+    bool skip_field() {
+        const char* sep = scanner.next(cursor);
+        if (sep == end) {
+            if (scanner.unterminated()) {
+                unterminated(cursor);
+            }
+            cursor = sep;
+            return true;
+        }
+        cursor = sep + 1;
+        return *sep == '\n';
+    }
+
+    // skip empty lines, return false if end of range is reached
+    bool skip_blank_lines() {
+        while (cursor != end && (*cursor == '\n' || *cursor == '\r')) ++cursor;
+        return cursor != end;
+    }
+
+    // tokenize the next row passing each selected field to
+    // on_field, fields in excess are detected before being passed
+    template <typename F>
+    void next_row(F&& on_field) {
+        const char* row_begin = cursor;
+        std::string_view field;
+        std::size_t fields{};
+        bool last{};
+        do {
+            if (fields == _column_count) {
+                // at least one field in excess
+                ++fields;
+                break;
+            }
+            if (selection.selected(fields)) {
+                last = next_field(field);
+                on_field(field);
+            } else {
+                last = skip_field();
+            }
+            ++fields;
+        } while (!last);
+        if (fields != _column_count || !last) {
+            using namespace std::literals;
+            throw std::runtime_error("Row at byte "s + std::to_string(offset(row_begin)) + " has "s + (last ? std::to_string(fields) : "more"s) + " fields instead of "s + std::to_string(_column_count));
+        }
+    }
+
+    // fill holder with rows until it is full or
+    // the end of the range is reached
+    void fill_block() {
+        while (!holder->full() && skip_blank_lines()) {
+            next_row([this](std::string_view field){
+                holder->push_field(field);
+            });
+            holder->end_row();
+        }
+    }
+
+public:
+    mmap_reader(std::string filename, std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr)
+    : mmap_reader(std::move(filename), row_queue_smart_ptr.get())
+    {
+        this->row_queue_smart_ptr = std::move(row_queue_smart_ptr);
+    }
+
+    mmap_reader(std::string filename, lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr)
+    : input(std::make_shared<const mapped_file>(std::move(filename))),
+      cursor{input->begin()}, end{input->end()}, scanner(cursor, end), row_queue_ptr{row_queue_ptr}
+    {
+        // skip UTF-8 BOM, if any
+        if (input->size() >= 3 && std::string_view(cursor, 3) == "\xEF\xBB\xBF") {
+            cursor += 3;
+        }
+        // header is used only to get column count
+        if (skip_blank_lines()) {
+            std::string_view field;
+            do {
+                ++_column_count;
+            } while (!next_field(field));
+        }
+        selection = column_selection(_column_count);
+    }
+
+    // reader for the rows beginning in [begin, end) of an already
+    // mapped file, begin must be the beginning of a row
+    mmap_reader(std::shared_ptr<const mapped_file> input, const char* begin, const char* end, std::size_t column_count,
+        lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr
+    )
+    : input{std::move(input)}, cursor{begin}, end{end}, scanner(begin, end), _column_count{column_count},
+      selection(column_count), row_queue_ptr{row_queue_ptr}
+    {}
+
+    // pass on only the given columns, to be called before
+    // reading and splitting
+    void select_columns(column_selection selection) {
+        if (selection.total() != _column_count) {
+            throw std::logic_error("Column selection does not match input columns");
+        }
+        this->selection = std::move(selection);
+    }
+
+    // split the rows not yet read in n byte ranges of similar size,
+    // each one assigned to one of the returned readers (sharing the
+    // same output queue), this reader is left with no rows to read.
+    // Ranges are resynchronized on the first new line following
+    // their nominal beginning. This is wrong only if the new line
+    // belongs to a quoted field: in that case the reader of the
+    // previous range reaches its end inside the quoted field and
+    // fails, so a wrong split is always detected
+    std::vector<std::unique_ptr<mmap_reader>> split(std::size_t n) {
+        if (holder) {
+            throw std::logic_error("Cannot split a reader holding a row");
+        }
+        std::vector<std::unique_ptr<mmap_reader>> ans;
+        ans.reserve(n);
+        const std::size_t length = end - cursor;
+        // beginning of the previous range
+        const char* prev = end;
+        for (std::size_t i{n-1}; i!=0; --i) {
+            // nominal beginning of the i-th range
+            const char* begin = cursor + length / n * i;
+            // resynchronize on next row
+            begin = static_cast<const char*>(std::memchr(begin, '\n', prev - begin));
+            begin = begin ? begin + 1 : prev;
+            ans.emplace_back(new mmap_reader(input, begin, prev, _column_count, row_queue_ptr));
+            ans.back()->row_queue_smart_ptr = row_queue_smart_ptr;
+            ans.back()->selection = selection;
+            prev = begin;
+        }
+        // first range
+        if (n) {
+            ans.emplace_back(new mmap_reader(input, cursor, prev, _column_count, row_queue_ptr));
+            ans.back()->row_queue_smart_ptr = row_queue_smart_ptr;
+            ans.back()->selection = selection;
+        }
+        cursor = end;
+        return ans;
+    }
+
+    // consume a block of rows of the input and put
+    // parsed data are enqueued in the queue
+    // return true if data have been successfully inserted
+    // return false if there are no more data to read
+    bool consume_block() {
+        if (!holder) {
+            if (!skip_blank_lines()) {
+                throw end_of_inputs{};
+            }
+            holder = std::make_unique<row_block>(cursor, column_count(), row_block::default_rows(column_count()));
+            fill_block();
+        }
+        return row_queue_ptr->offer(holder);
+    }
+
+    // tokenize the next row passing its fields to on_field, without
+    // storing them anywhere (see fused_parser)
+    // return false if there are no more rows to read
+    template <typename F>
+    bool consume_row(F&& on_field) {
+        if (holder) {
+            throw std::logic_error("Cannot consume single rows while holding a block");
+        }
+        if (!skip_blank_lines()) {
+            return false;
+        }
+        next_row(on_field);
+        return true;
+    }
+
+    // consume blocks until the queue is full and the insertion fails
+    // return true if end of input is reached and false if an
+    // enqueeing is failed
+    bool consume_many()
+    try
+    {
+        while (consume_block());
+        return false;
+    }
+    catch (end_of_inputs&)
+    {
+        return true;
+    }
+
+    // return the number of column in the given dataset
+    // (only the selected ones)
+    std::size_t column_count() {
+        return selection.size();
+    }
+};
+
+
+#endif
@@ -0,0 +1,187 @@
+
+#ifndef NUMBER_PARSING
+#define NUMBER_PARSING
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../modules/CPP-math-utils/convertions.hh"
+
+/**
+ * Backends used to convert the text of a field, i.e. a range
+ * [begin, end) of chars, into a number. Each backend is a class
+ * exposing:
+ *  template <typename T> static T parse(const char* begin, const char* end)
+ * throwing std::invalid_argument if the range is not a number.
+ */
+namespace number_parsing {
+
+    [[noreturn]] inline void not_a_number(const char* begin, const char* end) {
+        using namespace std::literals;
+        throw std::invalid_argument("Cannot convert \""s + std::string(begin, end) + "\" to a number"s);
+    }
+
+    // powers of ten exactly representable by a double
+    constexpr double exact_powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // true if rounding d to a float could differ from rounding
+    // the exact value d was rounded from, i.e. if d lies on the
+    // midpoint between two floats (only normal doubles expected)
+    inline bool float_midpoint(double d) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        constexpr int dropped = std::numeric_limits<double>::digits - std::numeric_limits<float>::digits;
+        constexpr std::uint64_t mask = (std::uint64_t(1) << dropped) - 1;
+        return (bits & mask) == std::uint64_t(1) << (dropped - 1);
+    }
+
+    // try to convert a field made only of decimal digits, with an
+    // optional '-' sign and, for floating point types, an optional
+    // fractional part; return false if other chars are found or
+    // the value could not be computed exactly by the fast path
+    template <typename T>
+    bool parse_simple(const char* begin, const char* end, T& value) {
+        const bool negative = begin != end && *begin == '-';
+        if (negative) {
+            if (std::is_unsigned_v<T>) {
+                return false;
+            }
+            ++begin;
+        }
+        std::uint64_t acc{};
+        const char* p = begin;
+        for (; p != end; ++p) {
+            const unsigned digit = static_cast<unsigned char>(*p) - '0';
+            if (digit > 9) {
+                break;
+            }
+            acc = acc*10 + digit;
+        }
+        std::size_t digits = p - begin;
+        std::size_t decimals{};
+        if (p != end) {
+            if (std::is_integral_v<T> || *p != '.') {
+                return false;
+            }
+            const char* dot = p;
+            for (++p; p != end; ++p) {
+                const unsigned digit = static_cast<unsigned char>(*p) - '0';
+                if (digit > 9) {
+                    return false;
+                }
+                acc = acc*10 + digit;
+            }
+            decimals = p - dot - 1;
+            digits += decimals;
+        }
+        // values of 19 digits surely fit in 64 bits; for integral
+        // types stay within the digits that surely fit in T
+        constexpr auto max_digits = std::is_integral_v<T> ? std::numeric_limits<T>::digits10 : 19;
+        if (digits == 0 || digits > max_digits) {
+            return false;
+        }
+        if constexpr (std::is_floating_point_v<T>) {
+            if (decimals) {
+                // Clinger's fast path: both the digits and the power of
+                // ten are exact doubles, so the quotient is correctly
+                // rounded; a midpoint may be rounded twice for floats
+                if (std::is_same_v<T, long double>
+                        || acc > (std::uint64_t(1) << std::numeric_limits<double>::digits)
+                        || decimals >= std::size(exact_powers)) {
+                    return false;
+                }
+                const double quotient = static_cast<double>(acc) / exact_powers[decimals];
+                if (std::is_same_v<T, float> && float_midpoint(quotient)) {
+                    return false;
+                }
+                value = static_cast<T>(quotient);
+            } else {
+                // integer to floating point conversion is correctly
+                // rounded, as the one performed by from_chars
+                value = static_cast<T>(acc);
+            }
+        } else {
+            value = static_cast<T>(acc);
+        }
+        if (negative) {
+            value = -value;
+        }
+        return true;
+    }
+
+    // std::from_chars (Eisel-Lemire based in recent standard
+    // libraries), locale independent and working in place
+    struct from_chars {
+        template <typename T>
+        static T parse(const char* begin, const char* end) {
+            T ans{};
+            auto [ptr, ec] = std::from_chars(begin, end, ans);
+            if (ec != std::errc() || ptr != end) {
+                not_a_number(begin, end);
+            }
+            return ans;
+        }
+    };
+
+    // fields containing only digits, as is common for integer
+    // columns, and short fixed point decimals are converted by
+    // a specialized loop, all the others by from_chars
+    struct fast {
+        template <typename T>
+        static T parse(const char* begin, const char* end) {
+            T ans;
+            if (parse_simple(begin, end, ans)) {
+                return ans;
+            }
+            return from_chars::template parse<T>(begin, end);
+        }
+    };
+
+    // conversion provided by the math module, requires a
+    // std::string to be built for each field
+    struct legacy {
+        template <typename T>
+        static T parse(const char* begin, const char* end) {
+            return math::convertions::ston<T>(std::string(begin, end));
+        }
+    };
+}
+
+// backend used to convert fields
+#ifdef LEGACY_CONVERSION
+#pragma message "Convert fields using math::convertions::ston..."
+using number_parser = number_parsing::legacy;
+#else
+#pragma message "Convert fields using a fast path for simple numbers and std::from_chars..."
+using number_parser = number_parsing::fast;
+#endif
+
+// convert a single field into a number, views (see row_block)
+// are converted in place, without building any temporary string
+template <typename T>
+T field_to_number(std::string_view str) {
+    // behave like ston: ignore surrounding blanks and leading sign
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    if (!str.empty() && str.front() == '+') {
+        str.remove_prefix(1);
+    }
+    return number_parser::template parse<T>(str.data(), str.data() + str.size());
+}
+
+
+#endif
@@ -4,16 +4,24 @@
 
 #include <vector>
 #include <valarray>
+#include <chrono>
+#include <memory>
 
 #include "chunk.hh"
+#include "chunk_pool.hh"
+#include "chunk_tuning.hh"
+#include "chunk_split.hh"
+#include "column_pairs.hh"
+#include "rectangular_accumulator.hh"
+#include "triangular_accumulator.hh"
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
 #include "../modules/CPP-math-utils/correlation.hh"
 #include "../modules/CPP-math-utils/couple.hh"
 
 /**
  * @brief This class is intended to receive chunks and process them to
- * calculate the cross correlation of every column pairs. It relies on
- * CPU only.
+ * calculate the cross correlation of every column pairs (or of the
+ * pairs of a rectangle, see column_pairs). It relies on CPU only.
  * 
  * @tparam T numeric type to be used 
  */
@@ -21,6 +29,8 @@ template <typename T>
 class numeric_consumer {
     // number of columns to be analysed
     const std::size_t col_count;
+    // pairs of columns to be analysed
+    const column_pairs pairs;
 
 // INPUT queue: chunk queues to read data to analyze
     // used to support smart memory management
@@ -33,78 +43,255 @@ class numeric_consumer {
     // vector containing results, when it is returned, the object is invalidated
     std::valarray<math::statistics::pcc_partial<T>> partials;
 #else
-    // to perform computation in an efficient way;
-    math::statistics::multicolumn_pcc_accumulator<T> accumulator;
+    // to perform computation in an efficient way, the
+    // former for all pairs, the latter for a rectangle
+    std::unique_ptr<triangular_pcc_accumulator<T>> accumulator;
+    std::unique_ptr<rectangular_pcc_accumulator<T>> rectangle;
 #endif
 
     // new chunk to analize
     std::unique_ptr<chunk<T>> new_cnk;
+    // chunks not stored with the preferred layout are copied here
+    std::unique_ptr<chunk<T>> transposed;
+    // where chunks are given back, if any
+    chunk_pool<T>* pool{};
+    // if any, told how long each chunk takes (see chunk_tuning::tuner)
+    chunk_tuning::tuner* tuner{};
+    // polled when chunk_queue_ptr is empty, e.g. the
+    // queues of other NUMA nodes (see queues::remote_chunk_queues())
+    std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> remote_queues;
+    // if set, large chunks are shared with the other consumers
+    chunk_split::board<T>* board{};
+
+    // take a chunk from the own queue or else from a remote one
+    bool poll() {
+        if (chunk_queue_ptr->poll(new_cnk)) {
+            return true;
+        }
+        for (auto* queue : remote_queues) {
+            if (queue->poll(new_cnk)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
     // auxiliary function to perform computations
-    void compute() {
+    void compute(chunk<T>& cnk) {
 #ifdef BLACKHOLE
 #pragma message "BLACKHOLE: skip all computation!!!"
+        (void)cnk;
 #else
 #ifdef SLOW
         // filled row in the chunk
-        const auto chunk_rows = new_cnk->rows();
+        const auto chunk_rows = cnk.rows();
         const auto col_count_minus_1 = col_count - 1;
         // index of the item in the vector being update
         std::size_t couple_idx {};
+        if (pairs.rectangular()) {
+            for (const auto c1 : pairs.a()) {
+                const T* const col_1 = cnk.get_column(c1);
+                for (const auto c2 : pairs.b()) {
+                    const T* const col_2 = cnk.get_column(c2);
+                    partials[couple_idx++] += math::statistics::pearson_correlation_coefficient(col_1, col_2, chunk_rows);
+                }
+            }
+            return;
+        }
         for (std::size_t c1{}; c1 != col_count_minus_1; ++c1) {
-            const T* const col_1 = new_cnk->get_column(c1);
+            const T* const col_1 = cnk.get_column(c1);
             for (std::size_t c2{c1+1}; c2 != col_count; ++c2) {
-                const T* const col_2 = new_cnk->get_column(c2);
+                const T* const col_2 = cnk.get_column(c2);
                 partials[couple_idx++] += math::statistics::pearson_correlation_coefficient(col_1, col_2, chunk_rows);
             }
         }
 #else
-        accumulator.accumulate(
-            new_cnk->data(),
-            new_cnk->rows(),
-            new_cnk->cols(),
-            new_cnk->row_offset(),
-            new_cnk->column_offset()
-        );
+        if (rectangle) {
+            const auto padded_rows = cnk.zero_padding();
+            rectangle->accumulate(
+                cnk.data(),
+                cnk.rows(),
+                cnk.cols(),
+                cnk.row_offset(),
+                cnk.column_offset(),
+                padded_rows
+            );
+        } else {
+            accumulator->accumulate(
+                cnk.data(),
+                cnk.rows(),
+                cnk.cols(),
+                cnk.row_offset(),
+                cnk.column_offset()
+            );
+        }
 #endif
 #endif  // BLACKHOLE
     }
 
+#ifndef SLOW
+    // add the pairs of a tile of a shared chunk, the last tile
+    // completed reports the time taken by the whole chunk from
+    // when it was shared, then gives the chunk back
+    void compute_tile(chunk_split::shared_chunk<T>& shared, std::size_t tile) {
+        const auto& cnk = shared.get();
+        const auto rows = accumulator->tile_rows(tile, shared.tiles());
+        accumulator->accumulate_rows(cnk.data(), cnk.rows(), cnk.row_offset(), cnk.column_offset(), rows.first, rows.second, tile == 0);
+        if (shared.complete()) {
+            const auto ns = shared.elapsed_ns();
+            auto released = shared.release();
+            if (tuner) {
+                tuner->chunk_analysed(released->max_rows(), ns);
+            }
+            recycle_chunk(pool, released);
+        }
+    }
+
+    // analyse a tile of a chunk shared by another consumer, if any
+    bool help() {
+        const auto shared = board->find();
+        std::size_t tile;
+        if (!shared || !shared->take(tile)) {
+            return false;
+        }
+        compute_tile(*shared, tile);
+        return true;
+    }
+
+    // share new_cnk if large enough, then analyse
+    // its tiles until all have been taken
+    bool split() {
+        const auto tiles = chunk_split::tiles_for(pairs.size(), new_cnk->rows(), board->max_tiles());
+        if (tiles < 2) {
+            return false;
+        }
+        const auto shared = std::make_shared<chunk_split::shared_chunk<T>>(std::move(new_cnk), preferred_layout(), tiles);
+        board->publish(shared);
+        std::size_t tile;
+        while (shared->take(tile)) {
+            compute_tile(*shared, tile);
+        }
+        return true;
+    }
+#endif
+
 public:
+    numeric_consumer(column_pairs pairs,
+        std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr
+    )
+    : numeric_consumer(std::move(pairs), chunk_queue_smart_ptr.get())
+    {
+        this->chunk_queue_smart_ptr = std::move(chunk_queue_smart_ptr);
+    }
+
+    numeric_consumer(column_pairs pairs,
+        lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr
+    )
+    : col_count{pairs.cols()},
+      pairs{std::move(pairs)},
+      chunk_queue_ptr{chunk_queue_ptr}
+    {
+        reallocate();
+    }
+
     numeric_consumer(std::size_t col_count,
         std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr
     )
-    : col_count{col_count},
-      chunk_queue_smart_ptr{std::move(chunk_queue_smart_ptr)},
-      chunk_queue_ptr{this->chunk_queue_smart_ptr.get()},
-#ifdef SLOW
-      partials(col_count*(col_count-1)/2)
-#else
-      accumulator(col_count)
-#endif
+    : numeric_consumer(column_pairs(col_count), std::move(chunk_queue_smart_ptr))
     {}
 
     numeric_consumer(std::size_t col_count,
         lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr
     )
-    : col_count{col_count},
-      chunk_queue_ptr{chunk_queue_ptr},
+    : numeric_consumer(column_pairs(col_count), chunk_queue_ptr)
+    {}
+
+    // layout of the chunks analysed, the others are transposed
+    chunk_layout preferred_layout() const {
 #ifdef SLOW
-      partials(col_count*(col_count-1)/2)
+        // pairs are analysed on contiguous columns
+        return chunk_layout::by_columns;
 #else
-      accumulator(col_count)
+        // the accumulator of all the pairs loads blocks of items
+        // of each row, the one of the rectangle computes dot
+        // products of columns
+        return pairs.rectangular() ? chunk_layout::by_columns : chunk_layout::by_rows;
 #endif
-    {}
+    }
+
+    // give back analysed chunks to pool instead of deleting them
+    void set_chunk_pool(chunk_pool<T>* pool) {
+        this->pool = pool;
+    }
+
+    // report analysis times to tuner
+    void set_tuner(chunk_tuning::tuner* tuner) {
+        this->tuner = tuner;
+    }
+
+    // queues to steal chunks from when the own one is empty,
+    // stolen chunks are then recycled in the own pool
+    void set_remote_queues(std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> remote_queues) {
+        this->remote_queues = std::move(remote_queues);
+    }
+
+    // share chunks whose pairs are worth splitting among consumers
+    // (see chunk_split), only for the pairs of the triangle
+    void set_split_board(chunk_split::board<T>* board) {
+#if !defined(SLOW) && !defined(BLACKHOLE)
+        if (!pairs.rectangular()) {
+            this->board = board;
+        }
+#else
+        (void)board;
+#endif
+    }
+
+    // allocate the partial results again, to be called by the thread
+    // analysing chunks before the first one: their pages are then
+    // placed on its NUMA node
+    void reallocate() {
+#ifdef SLOW
+        partials = std::valarray<math::statistics::pcc_partial<T>>(pairs.size());
+#else
+        if (pairs.rectangular()) {
+            rectangle = std::make_unique<rectangular_pcc_accumulator<T>>(pairs.a(), pairs.b());
+        } else {
+            accumulator = std::make_unique<triangular_pcc_accumulator<T>>(col_count);
+        }
+#endif
+    }
 
     // try to extract a single chunk and process it
     // return true if a chunk is found, false otherwise
     bool analyze() {
         // try to extract a new chunk to analize
-        if (!chunk_queue_ptr->poll(new_cnk)) {
+        if (!poll()) {
+#ifndef SLOW
+            // or else help with the tiles of a shared one
+            if (board && help()) {
+                return true;
+            }
+#endif
+            if (tuner) {
+                tuner->queue_empty();
+            }
             return false;
         }
-        compute();
-        new_cnk.release();
+#ifndef SLOW
+        if (board && split()) {
+            return true;
+        }
+#endif
+        if (tuner) {
+            const auto start = std::chrono::steady_clock::now();
+            compute(with_layout(*new_cnk, preferred_layout(), transposed));
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            tuner->chunk_analysed(new_cnk->max_rows(), std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        } else {
+            compute(with_layout(*new_cnk, preferred_layout(), transposed));
+        }
+        recycle_chunk(pool, new_cnk);
         return true;
     }
 
@@ -119,7 +306,10 @@ public:
         return std::move(partials);
 #else
     std::valarray<math::statistics::pcc_partial<T>> get_results_and_invalidate() {
-        return accumulator.to_pcc_partial_valarray();
+        if (rectangle) {
+            return rectangle->to_pcc_partial_valarray();
+        }
+        return accumulator->to_pcc_partial_valarray();
 #endif
     }
 };
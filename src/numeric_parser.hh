@@ -5,15 +5,19 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <algorithm>
 
 #include "chunk.hh"
+#include "chunk_pool.hh"
+#include "chunk_tuning.hh"
+#include "row_block.hh"
+#include "number_parsing.hh"
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
-#include "../modules/CPP-math-utils/convertions.hh"
 
-
-// This object is used to continously extract rows
-// of string to be converted in numeric data 
+// This object is used to continously extract blocks of
+// rows of string to be converted in numeric data 
 template <typename T>
 class numeric_parser {
 public:
@@ -22,10 +26,16 @@ private:
     // how many rows in each chunk
     std::size_t rows_per_chunk = DEFAULT_ROW_NUMBER;
 
-    // row to parse
-    std::unique_ptr<std::vector<std::string>> new_row;
+    // block of rows to parse
+    std::unique_ptr<row_block> new_block;
+    // next row of new_block to be parsed
+    std::size_t next_row{};
     // chunk to fill
     std::unique_ptr<chunk<T>> curr_cnk;
+    // where chunks are taken from, if any
+    chunk_pool<T>* pool{};
+    // if any, decides the rows of new chunks instead of rows_per_chunk
+    chunk_tuning::tuner* tuner{};
     // chunk filled? If true try to insert it into output queue
     bool chunk_filled {};
 
@@ -34,10 +44,10 @@ private:
 
 // INPUT queue: string queues to obtain data to parse
     // used to support smart memory management
-    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> row_queue_smart_ptr;
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr;
     // the queue will be accessed by a row pointer allowing
     // this class to receive both smart and raw pointers 
-    lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>* row_queue_ptr;
+    lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr;
 
 // OUTPUT queue: chunk queues to store parsed data
     // used to support smart memory management
@@ -49,7 +59,7 @@ private:
 public:
     numeric_parser(
         std::size_t row_length,
-        std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> row_queue_smart_ptr,
+        std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr,
         std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunk_queue_smart_ptr
     )
     : row_length{row_length},
@@ -61,7 +71,7 @@ public:
 
     numeric_parser(
         std::size_t row_length,
-        lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>* row_queue_ptr,
+        lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr,
         lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* chunk_queue_ptr
     )
     : row_length{row_length},
@@ -77,6 +87,16 @@ public:
         this->rows_per_chunk = rows_per_chunk;
     }
 
+    // take chunks from pool instead of allocating them
+    void set_chunk_pool(chunk_pool<T>* pool) {
+        this->pool = pool;
+    }
+
+    // let tuner choose the rows of each chunk
+    void set_tuner(chunk_tuning::tuner* tuner) {
+        this->tuner = tuner;
+    }
+
     // read rows from the INPUT queue to get strings to parse
     // and partially build the next chunk
     // return true if a chunk as been successfully
@@ -94,17 +114,32 @@ public:
         } else {
             // pick new rows until chunk has been filled
             for (;;) {
-                // get new input row
-                if (!row_queue_ptr->poll(new_row)) {
-                    return false;
+                // get new input block, if previous one has been
+                // completely parsed
+                if (!new_block) {
+                    if (!row_queue_ptr->poll(new_block)) {
+                        return false;
+                    }
+                    next_row = 0;
                 }
                 if (!curr_cnk) {
-                    curr_cnk = std::make_unique<chunk<T>>(chunk<T>(rows_per_chunk, row_length));
+                    curr_cnk = acquire_chunk(pool, tuner ? tuner->rows() : rows_per_chunk, row_length);
+                    if (!curr_cnk) {
+                        // memory budget exhausted, rows are kept
+                        return false;
+                    }
+                }
+                // parse as many rows as the chunk can hold
+                const auto last_row = std::min(new_block->rows(), next_row + (curr_cnk->max_rows() - curr_cnk->rows()));
+                for (; next_row != last_row; ++next_row) {
+                    for (std::size_t c{}; c != row_length; ++c) {
+                        curr_cnk->unsafe_push_back(field_to_number<T>(new_block->field(next_row, c)));
+                    }
                 }
-                for (const auto& str : *new_row) {
-                    curr_cnk->unsafe_push_back(math::convertions::ston<T>(str));
+                if (next_row == new_block->rows()) {
+                    // block completely parsed
+                    new_block.reset();
                 }
-                new_row.release();
                 // check if chunk is full
                 if (curr_cnk->full()) {
                     // try to insert
@@ -154,6 +189,12 @@ public:
     bool hold_filled() const {
         return chunk_filled;
     }
+
+    // return true if rows already taken from the INPUT queue are
+    // still to be parsed (e.g. no chunk could be allocated)
+    bool hold_rows() const {
+        return new_block != nullptr;
+    }
 };
 
 
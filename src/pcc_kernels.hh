@@ -0,0 +1,558 @@
+#ifndef PCC_KERNELS
+#define PCC_KERNELS
+
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+#include "cpu_features.hh"
+
+#ifdef X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Kernels of the accumulator of all the pairs (see
+ * triangular_pcc_accumulator) on a block of rows of a table stored
+ * by rows: sums and sums of squares of the columns, sums of the
+ * products of the pairs; and of the accumulator of a rectangle of
+ * pairs (see rectangular_pcc_accumulator) on contiguous columns: dot
+ * products of the columns. They are written once on the operations of
+ * a SIMD register and compiled for SSE2 (the baseline of x86-64),
+ * AVX2 with FMA and AVX-512, for float and double: the widest one
+ * supported by the CPU is chosen when the program starts, so that
+ * the same binary uses all the width of every host.
+ */
+namespace pcc_kernels {
+
+    // columns i of a block of sums kept in registers
+    constexpr std::size_t MR = 4;
+
+    // sums and sums of squares of the cols columns of the
+    // rows of x, added to sums and squares
+    template <typename T>
+    using sums_routine = void (*)(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols, T* sums, T* squares);
+
+    // sums of the products of the pairs (i,j), i < j, whose column i
+    // is in [ib, ie) and whose column j is in [jb, je), added to
+    // products[starts[i] + j - i - 1]
+    template <typename T>
+    using products_routine = void (*)(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts);
+
+    // dot products of the columns xs[k] (k < nx) with the columns
+    // ys[j] (j < ny), rows items each, added to products[k*stride + j];
+    // if aligned, all the columns start at a cache line and rows is a
+    // multiple of its items: they are read without a tail
+    template <typename T>
+    using dots_routine = void (*)(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride, bool aligned);
+
+    template <typename T>
+    struct routines {
+        sums_routine<T> sums;
+        products_routine<T> products;
+        dots_routine<T> dots;
+        // columns j of a block of sums kept in registers
+        std::size_t width;
+        const char* name;
+    };
+
+    // pairs of column i with the columns from j_begin to j_end, one
+    // at a time, for the edges of the blocks and for any layout
+    template <typename T>
+    void pairs(const T* x, std::size_t rows, std::size_t row_offset, std::size_t column_offset,
+        std::size_t i, std::size_t j_begin, std::size_t j_end, T* products, const std::size_t* starts
+    ) {
+        for (std::size_t j{j_begin}; j < j_end; ++j) {
+            T s{};
+            for (std::size_t r{}; r != rows; ++r) {
+                const T* const row = x + r*row_offset;
+                s += row[i*column_offset]*row[j*column_offset];
+            }
+            products[starts[i] + j - i - 1] += s;
+        }
+    }
+
+    // operations on a register of one item, where SIMD is not available
+    template <typename T>
+    struct scalar_ops {
+        typedef T reg;
+        static constexpr std::size_t lanes = 1;
+        static reg zero() { return T{}; }
+        static reg load(const T* p) { return *p; }
+        static reg load_aligned(const T* p) { return *p; }
+        static reg broadcast(T x) { return x; }
+        // a*b + c
+        static reg fmadd(reg a, reg b, reg c) { return a*b + c; }
+        static reg add(reg a, reg b) { return a + b; }
+        static void add_store(T* p, reg v) { *p += v; }
+    };
+
+    // bodies are compiled only inlined in routines targeting the
+    // registers they use, their calls never pass them in memory
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+    // sums of the columns lanes at a time, each in registers
+    // while the rows are scanned
+    template <typename O, typename T>
+    __attribute__((always_inline)) inline void sums_body(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols,
+        T* sums, T* squares
+    ) {
+        std::size_t c{};
+        for (; c + O::lanes <= cols; c += O::lanes) {
+            auto s = O::zero(), q = O::zero();
+            for (std::size_t r{}; r != rows; ++r) {
+                const auto v = O::load(x + r*row_offset + c);
+                s = O::add(s, v);
+                q = O::fmadd(v, v, q);
+            }
+            O::add_store(sums + c, s);
+            O::add_store(squares + c, q);
+        }
+        for (; c != cols; ++c) {
+            T s{}, q{};
+            for (std::size_t r{}; r != rows; ++r) {
+                const T v = x[r*row_offset + c];
+                s += v;
+                q += v*v;
+            }
+            sums[c] += s;
+            squares[c] += q;
+        }
+    }
+
+    // sums of the products of the columns from i to i + MR with the
+    // columns from j to j + 2*lanes, in 8 registers, a row at a time
+    template <typename O, typename T>
+    __attribute__((always_inline)) inline void kernel(const T* x, std::size_t rows, std::size_t row_offset, std::size_t i, std::size_t j,
+        T* products, const std::size_t* starts
+    ) {
+        auto c00 = O::zero(), c01 = O::zero(), c10 = O::zero(), c11 = O::zero();
+        auto c20 = O::zero(), c21 = O::zero(), c30 = O::zero(), c31 = O::zero();
+        for (std::size_t r{}; r != rows; ++r) {
+            const T* const row = x + r*row_offset;
+            const auto y0 = O::load(row + j);
+            const auto y1 = O::load(row + j + O::lanes);
+            auto a = O::broadcast(row[i]);
+            c00 = O::fmadd(a, y0, c00);
+            c01 = O::fmadd(a, y1, c01);
+            a = O::broadcast(row[i+1]);
+            c10 = O::fmadd(a, y0, c10);
+            c11 = O::fmadd(a, y1, c11);
+            a = O::broadcast(row[i+2]);
+            c20 = O::fmadd(a, y0, c20);
+            c21 = O::fmadd(a, y1, c21);
+            a = O::broadcast(row[i+3]);
+            c30 = O::fmadd(a, y0, c30);
+            c31 = O::fmadd(a, y1, c31);
+        }
+        T* p = products + starts[i] + j - i - 1;
+        O::add_store(p, c00);
+        O::add_store(p + O::lanes, c01);
+        p = products + starts[i+1] + j - i - 2;
+        O::add_store(p, c10);
+        O::add_store(p + O::lanes, c11);
+        p = products + starts[i+2] + j - i - 3;
+        O::add_store(p, c20);
+        O::add_store(p + O::lanes, c21);
+        p = products + starts[i+3] + j - i - 4;
+        O::add_store(p, c30);
+        O::add_store(p + O::lanes, c31);
+    }
+
+    // as kernel, with the columns from j to j + lanes
+    template <typename O, typename T>
+    __attribute__((always_inline)) inline void narrow_kernel(const T* x, std::size_t rows, std::size_t row_offset, std::size_t i, std::size_t j,
+        T* products, const std::size_t* starts
+    ) {
+        auto c0 = O::zero(), c1 = O::zero(), c2 = O::zero(), c3 = O::zero();
+        for (std::size_t r{}; r != rows; ++r) {
+            const T* const row = x + r*row_offset;
+            const auto y = O::load(row + j);
+            c0 = O::fmadd(O::broadcast(row[i]), y, c0);
+            c1 = O::fmadd(O::broadcast(row[i+1]), y, c1);
+            c2 = O::fmadd(O::broadcast(row[i+2]), y, c2);
+            c3 = O::fmadd(O::broadcast(row[i+3]), y, c3);
+        }
+        O::add_store(products + starts[i] + j - i - 1, c0);
+        O::add_store(products + starts[i+1] + j - i - 2, c1);
+        O::add_store(products + starts[i+2] + j - i - 3, c2);
+        O::add_store(products + starts[i+3] + j - i - 4, c3);
+    }
+
+    // MR columns i at a time, the pairs among them and
+    // the last columns of the block one at a time
+    template <typename O, typename T>
+    __attribute__((always_inline)) inline void products_body(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts
+    ) {
+        ie = std::min(ie, je);
+        std::size_t i{ib};
+        for (; i + MR <= ie; i += MR) {
+            // pairs inside the MR columns, or before the block
+            const std::size_t j_begin = std::max(jb, i + MR);
+            for (std::size_t k{i}; k != i + MR; ++k) {
+                pairs(x, rows, row_offset, 1, k, std::max(jb, k + 1), std::min(je, j_begin), products, starts);
+            }
+            std::size_t j{j_begin};
+            for (; j + 2*O::lanes <= je; j += 2*O::lanes) {
+                kernel<O>(x, rows, row_offset, i, j, products, starts);
+            }
+            if (j + O::lanes <= je) {
+                narrow_kernel<O>(x, rows, row_offset, i, j, products, starts);
+                j += O::lanes;
+            }
+            for (std::size_t k{i}; k != i + MR; ++k) {
+                pairs(x, rows, row_offset, 1, k, j, je, products, starts);
+            }
+        }
+        for (; i < ie; ++i) {
+            pairs(x, rows, row_offset, 1, i, std::max(jb, i + 1), je, products, starts);
+        }
+    }
+
+    // sum of the lanes of a register
+    template <typename O, typename T>
+    __attribute__((always_inline)) inline T reduce(const typename O::reg& v) {
+        T items[O::lanes]{};
+        O::add_store(items, v);
+        T ans{};
+        for (std::size_t k{}; k != O::lanes; ++k) {
+            ans += items[k];
+        }
+        return ans;
+    }
+
+    // dot product of x and y from the row begin, one item at a time
+    template <typename T>
+    inline T dot_tail(const T* x, const T* y, std::size_t begin, std::size_t rows) {
+        T s{};
+        for (std::size_t r{begin}; r < rows; ++r) {
+            s += x[r]*y[r];
+        }
+        return s;
+    }
+
+    // MR columns x and 2 columns y at a time, 8 sums in registers
+    // while the rows are scanned, the remaining columns one by one;
+    // if aligned, columns start at a register and rows are read with
+    // aligned loads (see dots_routine)
+    template <typename O, bool aligned, typename T>
+    __attribute__((always_inline)) inline void dots_body(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride
+    ) {
+        const std::size_t vrows = rows / O::lanes * O::lanes;
+        std::size_t k{};
+        for (; k + MR <= nx; k += MR) {
+            const T* const x0 = xs[k];
+            const T* const x1 = xs[k+1];
+            const T* const x2 = xs[k+2];
+            const T* const x3 = xs[k+3];
+            T* const p = products + k*stride;
+            std::size_t j{};
+            for (; j + 2 <= ny; j += 2) {
+                const T* const y0 = ys[j];
+                const T* const y1 = ys[j+1];
+                auto c00 = O::zero(), c01 = O::zero(), c10 = O::zero(), c11 = O::zero();
+                auto c20 = O::zero(), c21 = O::zero(), c30 = O::zero(), c31 = O::zero();
+                for (std::size_t r{}; r != vrows; r += O::lanes) {
+                    const auto v0 = aligned ? O::load_aligned(y0 + r) : O::load(y0 + r);
+                    const auto v1 = aligned ? O::load_aligned(y1 + r) : O::load(y1 + r);
+                    auto a = aligned ? O::load_aligned(x0 + r) : O::load(x0 + r);
+                    c00 = O::fmadd(a, v0, c00);
+                    c01 = O::fmadd(a, v1, c01);
+                    a = aligned ? O::load_aligned(x1 + r) : O::load(x1 + r);
+                    c10 = O::fmadd(a, v0, c10);
+                    c11 = O::fmadd(a, v1, c11);
+                    a = aligned ? O::load_aligned(x2 + r) : O::load(x2 + r);
+                    c20 = O::fmadd(a, v0, c20);
+                    c21 = O::fmadd(a, v1, c21);
+                    a = aligned ? O::load_aligned(x3 + r) : O::load(x3 + r);
+                    c30 = O::fmadd(a, v0, c30);
+                    c31 = O::fmadd(a, v1, c31);
+                }
+                p[j] += reduce<O, T>(c00) + dot_tail(x0, y0, vrows, rows);
+                p[j+1] += reduce<O, T>(c01) + dot_tail(x0, y1, vrows, rows);
+                p[stride + j] += reduce<O, T>(c10) + dot_tail(x1, y0, vrows, rows);
+                p[stride + j+1] += reduce<O, T>(c11) + dot_tail(x1, y1, vrows, rows);
+                p[2*stride + j] += reduce<O, T>(c20) + dot_tail(x2, y0, vrows, rows);
+                p[2*stride + j+1] += reduce<O, T>(c21) + dot_tail(x2, y1, vrows, rows);
+                p[3*stride + j] += reduce<O, T>(c30) + dot_tail(x3, y0, vrows, rows);
+                p[3*stride + j+1] += reduce<O, T>(c31) + dot_tail(x3, y1, vrows, rows);
+            }
+            if (j != ny) {
+                const T* const y = ys[j];
+                auto c0 = O::zero(), c1 = O::zero(), c2 = O::zero(), c3 = O::zero();
+                for (std::size_t r{}; r != vrows; r += O::lanes) {
+                    const auto v = aligned ? O::load_aligned(y + r) : O::load(y + r);
+                    auto a = aligned ? O::load_aligned(x0 + r) : O::load(x0 + r);
+                    c0 = O::fmadd(a, v, c0);
+                    a = aligned ? O::load_aligned(x1 + r) : O::load(x1 + r);
+                    c1 = O::fmadd(a, v, c1);
+                    a = aligned ? O::load_aligned(x2 + r) : O::load(x2 + r);
+                    c2 = O::fmadd(a, v, c2);
+                    a = aligned ? O::load_aligned(x3 + r) : O::load(x3 + r);
+                    c3 = O::fmadd(a, v, c3);
+                }
+                p[j] += reduce<O, T>(c0) + dot_tail(x0, y, vrows, rows);
+                p[stride + j] += reduce<O, T>(c1) + dot_tail(x1, y, vrows, rows);
+                p[2*stride + j] += reduce<O, T>(c2) + dot_tail(x2, y, vrows, rows);
+                p[3*stride + j] += reduce<O, T>(c3) + dot_tail(x3, y, vrows, rows);
+            }
+        }
+        for (; k != nx; ++k) {
+            const T* const x = xs[k];
+            for (std::size_t j{}; j != ny; ++j) {
+                const T* const y = ys[j];
+                // two sums to hide the latency of the additions
+                auto c0 = O::zero(), c1 = O::zero();
+                std::size_t r{};
+                for (; r + 2*O::lanes <= vrows; r += 2*O::lanes) {
+                    auto a = aligned ? O::load_aligned(x + r) : O::load(x + r);
+                    auto v = aligned ? O::load_aligned(y + r) : O::load(y + r);
+                    c0 = O::fmadd(a, v, c0);
+                    a = aligned ? O::load_aligned(x + r + O::lanes) : O::load(x + r + O::lanes);
+                    v = aligned ? O::load_aligned(y + r + O::lanes) : O::load(y + r + O::lanes);
+                    c1 = O::fmadd(a, v, c1);
+                }
+                if (r != vrows) {
+                    const auto a = aligned ? O::load_aligned(x + r) : O::load(x + r);
+                    const auto v = aligned ? O::load_aligned(y + r) : O::load(y + r);
+                    c0 = O::fmadd(a, v, c0);
+                }
+                products[k*stride + j] += reduce<O, T>(O::add(c0, c1)) + dot_tail(x, y, vrows, rows);
+            }
+        }
+    }
+
+#pragma GCC diagnostic pop
+
+    template <typename T>
+    void sums_scalar(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols, T* sums, T* squares) {
+        sums_body<scalar_ops<T>>(x, rows, row_offset, cols, sums, squares);
+    }
+
+    template <typename T>
+    void products_scalar(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts
+    ) {
+        products_body<scalar_ops<T>>(x, rows, row_offset, ib, ie, jb, je, products, starts);
+    }
+
+    template <typename T>
+    void dots_scalar(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride, bool aligned
+    ) {
+        if (aligned) {
+            dots_body<scalar_ops<T>, true>(xs, nx, ys, ny, rows, products, stride);
+        } else {
+            dots_body<scalar_ops<T>, false>(xs, nx, ys, ny, rows, products, stride);
+        }
+    }
+
+    template <typename T>
+    routines<T> scalar() {
+        return {sums_scalar<T>, products_scalar<T>, dots_scalar<T>, 2*scalar_ops<T>::lanes, "scalar"};
+    }
+
+#ifdef X86_SIMD
+    // operations on SSE2 registers, without FMA
+    template <typename T>
+    struct sse2_ops;
+
+    template <>
+    struct sse2_ops<double> {
+        typedef __m128d reg;
+        static constexpr std::size_t lanes = 2;
+        static reg zero() { return _mm_setzero_pd(); }
+        static reg load(const double* p) { return _mm_loadu_pd(p); }
+        static reg load_aligned(const double* p) { return _mm_load_pd(p); }
+        static reg broadcast(double x) { return _mm_set1_pd(x); }
+        static reg fmadd(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+        static void add_store(double* p, reg v) { _mm_storeu_pd(p, _mm_add_pd(_mm_loadu_pd(p), v)); }
+    };
+
+    template <>
+    struct sse2_ops<float> {
+        typedef __m128 reg;
+        static constexpr std::size_t lanes = 4;
+        static reg zero() { return _mm_setzero_ps(); }
+        static reg load(const float* p) { return _mm_loadu_ps(p); }
+        static reg load_aligned(const float* p) { return _mm_load_ps(p); }
+        static reg broadcast(float x) { return _mm_set1_ps(x); }
+        static reg fmadd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+        static void add_store(float* p, reg v) { _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), v)); }
+    };
+
+    // operations on AVX2 registers, with FMA
+    template <typename T>
+    struct avx2_ops;
+
+    template <>
+    struct avx2_ops<double> {
+        typedef __m256d reg;
+        static constexpr std::size_t lanes = 4;
+        __attribute__((target("avx2,fma"))) static reg zero() { return _mm256_setzero_pd(); }
+        __attribute__((target("avx2,fma"))) static reg load(const double* p) { return _mm256_loadu_pd(p); }
+        __attribute__((target("avx2,fma"))) static reg load_aligned(const double* p) { return _mm256_load_pd(p); }
+        __attribute__((target("avx2,fma"))) static reg broadcast(double x) { return _mm256_set1_pd(x); }
+        __attribute__((target("avx2,fma"))) static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+        __attribute__((target("avx2,fma"))) static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+        __attribute__((target("avx2,fma"))) static void add_store(double* p, reg v) { _mm256_storeu_pd(p, _mm256_add_pd(_mm256_loadu_pd(p), v)); }
+    };
+
+    template <>
+    struct avx2_ops<float> {
+        typedef __m256 reg;
+        static constexpr std::size_t lanes = 8;
+        __attribute__((target("avx2,fma"))) static reg zero() { return _mm256_setzero_ps(); }
+        __attribute__((target("avx2,fma"))) static reg load(const float* p) { return _mm256_loadu_ps(p); }
+        __attribute__((target("avx2,fma"))) static reg load_aligned(const float* p) { return _mm256_load_ps(p); }
+        __attribute__((target("avx2,fma"))) static reg broadcast(float x) { return _mm256_set1_ps(x); }
+        __attribute__((target("avx2,fma"))) static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+        __attribute__((target("avx2,fma"))) static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+        __attribute__((target("avx2,fma"))) static void add_store(float* p, reg v) { _mm256_storeu_ps(p, _mm256_add_ps(_mm256_loadu_ps(p), v)); }
+    };
+
+    // operations on AVX-512 registers
+    template <typename T>
+    struct avx512_ops;
+
+    template <>
+    struct avx512_ops<double> {
+        typedef __m512d reg;
+        static constexpr std::size_t lanes = 8;
+        __attribute__((target("avx512f"))) static reg zero() { return _mm512_setzero_pd(); }
+        __attribute__((target("avx512f"))) static reg load(const double* p) { return _mm512_loadu_pd(p); }
+        __attribute__((target("avx512f"))) static reg load_aligned(const double* p) { return _mm512_load_pd(p); }
+        __attribute__((target("avx512f"))) static reg broadcast(double x) { return _mm512_set1_pd(x); }
+        __attribute__((target("avx512f"))) static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+        __attribute__((target("avx512f"))) static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+        __attribute__((target("avx512f"))) static void add_store(double* p, reg v) { _mm512_storeu_pd(p, _mm512_add_pd(_mm512_loadu_pd(p), v)); }
+    };
+
+    template <>
+    struct avx512_ops<float> {
+        typedef __m512 reg;
+        static constexpr std::size_t lanes = 16;
+        __attribute__((target("avx512f"))) static reg zero() { return _mm512_setzero_ps(); }
+        __attribute__((target("avx512f"))) static reg load(const float* p) { return _mm512_loadu_ps(p); }
+        __attribute__((target("avx512f"))) static reg load_aligned(const float* p) { return _mm512_load_ps(p); }
+        __attribute__((target("avx512f"))) static reg broadcast(float x) { return _mm512_set1_ps(x); }
+        __attribute__((target("avx512f"))) static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+        __attribute__((target("avx512f"))) static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+        __attribute__((target("avx512f"))) static void add_store(float* p, reg v) { _mm512_storeu_ps(p, _mm512_add_ps(_mm512_loadu_ps(p), v)); }
+    };
+
+    template <typename T>
+    void sums_sse2(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols, T* sums, T* squares) {
+        sums_body<sse2_ops<T>>(x, rows, row_offset, cols, sums, squares);
+    }
+
+    template <typename T>
+    void products_sse2(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts
+    ) {
+        products_body<sse2_ops<T>>(x, rows, row_offset, ib, ie, jb, je, products, starts);
+    }
+
+    template <typename T>
+    void dots_sse2(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride, bool aligned
+    ) {
+        if (aligned) {
+            dots_body<sse2_ops<T>, true>(xs, nx, ys, ny, rows, products, stride);
+        } else {
+            dots_body<sse2_ops<T>, false>(xs, nx, ys, ny, rows, products, stride);
+        }
+    }
+
+    template <typename T>
+    __attribute__((target("avx2,fma"), flatten))
+    void sums_avx2(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols, T* sums, T* squares) {
+        sums_body<avx2_ops<T>>(x, rows, row_offset, cols, sums, squares);
+    }
+
+    template <typename T>
+    __attribute__((target("avx2,fma"), flatten))
+    void products_avx2(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts
+    ) {
+        products_body<avx2_ops<T>>(x, rows, row_offset, ib, ie, jb, je, products, starts);
+    }
+
+    template <typename T>
+    __attribute__((target("avx2,fma"), flatten))
+    void dots_avx2(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride, bool aligned
+    ) {
+        if (aligned) {
+            dots_body<avx2_ops<T>, true>(xs, nx, ys, ny, rows, products, stride);
+        } else {
+            dots_body<avx2_ops<T>, false>(xs, nx, ys, ny, rows, products, stride);
+        }
+    }
+
+    template <typename T>
+    __attribute__((target("avx512f"), flatten))
+    void sums_avx512(const T* x, std::size_t rows, std::size_t row_offset, std::size_t cols, T* sums, T* squares) {
+        sums_body<avx512_ops<T>>(x, rows, row_offset, cols, sums, squares);
+    }
+
+    template <typename T>
+    __attribute__((target("avx512f"), flatten))
+    void products_avx512(const T* x, std::size_t rows, std::size_t row_offset,
+        std::size_t ib, std::size_t ie, std::size_t jb, std::size_t je, T* products, const std::size_t* starts
+    ) {
+        products_body<avx512_ops<T>>(x, rows, row_offset, ib, ie, jb, je, products, starts);
+    }
+
+    template <typename T>
+    __attribute__((target("avx512f"), flatten))
+    void dots_avx512(const T* const* xs, std::size_t nx, const T* const* ys, std::size_t ny,
+        std::size_t rows, T* products, std::size_t stride, bool aligned
+    ) {
+        if (aligned) {
+            dots_body<avx512_ops<T>, true>(xs, nx, ys, ny, rows, products, stride);
+        } else {
+            dots_body<avx512_ops<T>, false>(xs, nx, ys, ny, rows, products, stride);
+        }
+    }
+
+    template <typename T>
+    routines<T> sse2() {
+        return {sums_sse2<T>, products_sse2<T>, dots_sse2<T>, 2*sse2_ops<T>::lanes, "sse2"};
+    }
+
+    template <typename T>
+    routines<T> avx2() {
+        return {sums_avx2<T>, products_avx2<T>, dots_avx2<T>, 2*avx2_ops<T>::lanes, "avx2"};
+    }
+
+    template <typename T>
+    routines<T> avx512() {
+        return {sums_avx512<T>, products_avx512<T>, dots_avx512<T>, 2*avx512_ops<T>::lanes, "avx512"};
+    }
+#endif
+
+    // widest routines supported by the CPU for T
+    template <typename T>
+    routines<T> best() {
+#ifdef X86_SIMD
+        if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+            static const routines<T> ans = cpu_features::has_avx512f() ? avx512<T>()
+                : cpu_features::has_avx2() && cpu_features::has_fma() ? avx2<T>()
+                : sse2<T>();
+            return ans;
+        }
+#endif
+        return scalar<T>();
+    }
+}
+
+
+#endif
@@ -5,10 +5,22 @@
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
 
 #include "chunk.hh"
+#include "chunk_pool.hh"
+#include "memory_budget.hh"
+#include "chunk_tuning.hh"
+#include "row_block.hh"
+#include "topology.hh"
+#include "wait_strategy.hh"
+#include "work_stealing.hh"
+#include "stage_roles.hh"
+#include "chunk_split.hh"
 
 #include <atomic>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
 
 /**
  * The main thread and the worker threads use some
@@ -24,38 +36,96 @@
 template <typename T>
 struct queues {
 
-    // a lot of rows are expected to be parsed
-    constexpr static std::size_t ROW_QUEUE_SIZE = 100000;
+    // a lot of rows are expected to be parsed, but each
+    // slot of the queue holds a whole block of rows
+    constexpr static std::size_t ROW_QUEUE_SIZE = 128;
     // chunk are big: the queue is not expected to grow a lot
     constexpr static std::size_t CHUNK_QUEUE_SIZE = 100;
+    // bytes of a block of rows, assuming fields of 16 chars
+    constexpr static std::size_t ROW_BLOCK_BYTES = row_block::DEFAULT_FIELDS*(2*sizeof(std::uint32_t) + 16);
 
     // specify number of workers that will be used, necessary
     // to estimate end of processing
     const unsigned int worker_count;
 
     std::size_t rows_per_chunk = 0; // 0 means default
+    // if set, rows of chunks change while they are analysed
+    std::shared_ptr<chunk_tuning::tuner> tuner;
+
+    // workers tokenize and convert their own input in a single
+    // step (see fused_parser), row queue is not used
+    bool fused = false;
 
     // queue to be used to transmit 
-    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> rowQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>>(
-        new lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>(ROW_QUEUE_SIZE)
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> rowQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>>(
+        new lockfree_queue::fixed_size_lockfree_queue<row_block>(ROW_QUEUE_SIZE)
     );
     // queue to be used to transmit chunk to be analysed
     std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>> chunkQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>>(
         new lockfree_queue::fixed_size_lockfree_queue<chunk<T>>(CHUNK_QUEUE_SIZE)
     );
 
+    // chunks analysed are given back here to be filled again, it
+    // holds as many chunks as can be queued plus the ones held by
+    // the workers
+    std::shared_ptr<chunk_pool<T>> chunkPool;
+
+    // if set, bytes of the chunks alive are taken from it and
+    // the row queue is sized by it (see set_max_memory())
+    std::shared_ptr<memory_budget> budget;
+
+    // NUMA mode (see set_numa_nodes()): worker i runs on node
+    // i % numa_nodes.size() and fills and analyses chunks of the
+    // queue of its node, others are polled only when it is empty
+    std::vector<topology::node> numa_nodes;
+    std::vector<std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>>> nodeChunkQueues;
+    // chunks are recycled on the node they were allocated on
+    std::vector<std::shared_ptr<chunk_pool<T>>> nodeChunkPools;
+
+    // if set, workers parse or analyse as told by the
+    // controller (see stage_roles.hh)
+    std::unique_ptr<stage_roles::assignment> roles;
+
+    // if set, large chunks are analysed by several workers
+    // at once (see chunk_split.hh and set_split())
+    std::unique_ptr<chunk_split::board<T>> split;
+
+    // if not empty, the CPU each worker is pinned to
+    std::vector<unsigned> worker_cpus;
+
+    // chunks parsed by each worker, analysed first by the worker
+    // itself and stolen by the others when they have nothing to do
+    std::vector<std::unique_ptr<work_stealing::deque<chunk<T>>>> workerDeques;
+
+    // number of readers producing rows, each one has to
+    // mark the end of its input
+    unsigned int reader_count = 1;
+
     // flag to communicate:
-    //  end of input,
-    std::atomic_bool end_of_input{}; // set only by the main thread
+    //  end of input, - incremented once per reader
+    std::atomic_uint end_of_input{};
     //  end of str2num convertions, - incremented once per worker
     std::atomic_uint end_of_str2num{};
     //  end of chunk analysing - incremented once per worker
     std::atomic_uint end_of_analysis{};
+    //  some thread failed, every other one should stop
+    std::atomic_bool aborted{};
+
+    // what workers do when they find nothing to do
+    waiting::options wait_options;
+    // threads making progress (i.e. filling or emptying some
+    // queue) or changing the flags above wake the parked ones
+    waiting::eventcount activity;
 
     // default constructor
     queues(unsigned int workers)
-    : worker_count{workers}
-    {}
+    : worker_count{workers},
+      chunkPool{std::make_shared<chunk_pool<T>>(CHUNK_QUEUE_SIZE + (2 + work_stealing::DEQUE_SIZE)*workers)}
+    {
+        for (unsigned int i{}; i != workers; ++i) {
+            workerDeques.push_back(std::make_unique<work_stealing::deque<chunk<T>>>());
+        }
+    }
 
     // prevent moving and copyng
     queues(const queues&) = delete;
@@ -69,18 +139,222 @@ struct queues {
         this->rows_per_chunk = rows_per_chunk;
     }
 
-    /* no more input data will be generated */
+    // adapt the rows of chunks starting from rows_per_chunk
+    void set_adaptive_rows() {
+        tuner = std::make_shared<chunk_tuning::tuner>(rows_per_chunk);
+    }
+
+    void set_fused(bool fused) {
+        this->fused = fused;
+    }
+
+    // spread workers on the given NUMA nodes, with a chunk queue and
+    // a pool per node: must be called before workers are created
+    void set_numa_nodes(std::vector<topology::node> nodes) {
+        numa_nodes = std::move(nodes);
+        nodeChunkQueues.clear();
+        nodeChunkPools.clear();
+        if (numa_nodes.size() < 2) {
+            return;
+        }
+        const std::size_t n = numa_nodes.size();
+        // as many chunks in flight as with a single queue
+        const std::size_t queue_size = std::max<std::size_t>(2, CHUNK_QUEUE_SIZE / n);
+        for (std::size_t i{}; i != n; ++i) {
+            const std::size_t node_workers = worker_count / n + (i < worker_count % n);
+            nodeChunkQueues.push_back(std::make_shared<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>>(queue_size));
+            nodeChunkPools.push_back(std::make_shared<chunk_pool<T>>(queue_size + (2 + work_stealing::DEQUE_SIZE)*node_workers));
+            nodeChunkPools.back()->set_budget(budget.get());
+        }
+    }
+
+    // let the pipeline take at most about bytes: a quarter for the
+    // blocks of rows waiting to be parsed, the rest for the chunks;
+    // must be called before readers and workers are created
+    void set_max_memory(std::size_t bytes) {
+        const std::size_t row_blocks = std::clamp<std::size_t>(bytes/4/ROW_BLOCK_BYTES, 2, ROW_QUEUE_SIZE);
+        rowQueue = std::make_shared<lockfree_queue::fixed_size_lockfree_queue<row_block>>(row_blocks);
+        const std::size_t row_bytes = row_blocks*ROW_BLOCK_BYTES;
+        budget = std::make_shared<memory_budget>(bytes > 2*row_bytes ? bytes - row_bytes : bytes/2);
+        chunkPool->set_budget(budget.get());
+        for (auto& pool : nodeChunkPools) {
+            pool->set_budget(budget.get());
+        }
+    }
+
+    // reduce the rows of chunks (default_rows if not set) so that each
+    // worker can fill a chunk and analyse another within the budget,
+    // return true if they changed
+    bool fit_rows_per_chunk(std::size_t cols, std::size_t default_rows) {
+        const std::size_t chunks = 2*worker_count + 1;
+        constexpr std::size_t lanes = aligned_buffer::lanes<T>();
+        std::size_t rows = rows_per_chunk ? rows_per_chunk : default_rows;
+        const std::size_t original = rows;
+        while (rows > lanes && chunks*chunk_pool<T>::bytes(rows, cols) > budget->capacity()) {
+            rows = std::max(lanes, rows/2/lanes*lanes);
+        }
+        if (rows == original) {
+            return false;
+        }
+        set_rows_per_chunk(rows);
+        return true;
+    }
+
+    // index of the NUMA node of the given worker
+    std::size_t node_of(std::size_t worker) const {
+        return numa_nodes.empty() ? 0 : worker % numa_nodes.size();
+    }
+
+    // queue where the worker on node puts and takes its chunks
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>>* node_chunk_queue(std::size_t node) const {
+        return nodeChunkQueues.empty() ? chunkQueue.get() : nodeChunkQueues[node].get();
+    }
+
+    chunk_pool<T>* node_chunk_pool(std::size_t node) const {
+        return nodeChunkPools.empty() ? chunkPool.get() : nodeChunkPools[node].get();
+    }
+
+    // queues a worker on node polls when its own one is empty:
+    // the ones of the next nodes, then the global one, filled by
+    // the main thread with binary input
+    std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> remote_chunk_queues(std::size_t node) const {
+        std::vector<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>*> ans;
+        for (std::size_t i{1}; i < nodeChunkQueues.size(); ++i) {
+            ans.push_back(nodeChunkQueues[(node + i) % nodeChunkQueues.size()].get());
+        }
+        if (!nodeChunkQueues.empty()) {
+            ans.push_back(chunkQueue.get());
+        }
+        return ans;
+    }
+
+    // split the workers but the main one in a pool of parsers and one
+    // of analysers, must be called before workers are created
+    void set_stage_roles() {
+        roles = std::make_unique<stage_roles::assignment>(worker_count, worker_count/2);
+    }
+
+    // split the pairs of large chunks in up to tiles tiles, must
+    // be called before workers are created
+    void set_split(std::size_t tiles) {
+        split = std::make_unique<chunk_split::board<T>>(tiles, &activity);
+    }
+
+    stage_roles::role role_of(std::size_t worker) const {
+        return roles ? roles->of(worker) : stage_roles::role::any;
+    }
+
+    // synchronizations on the deques of all the workers
+    work_stealing::counters deque_stats() const {
+        work_stealing::counters ans;
+        for (const auto& d : workerDeques) {
+            ans += d->stats();
+        }
+        return ans;
+    }
+
+    // chunks waiting in the deques of the workers, over their capacity
+    double backlog() const {
+        std::size_t chunks{};
+        for (const auto& d : workerDeques) {
+            chunks += d->size();
+        }
+        return double(chunks) / (work_stealing::DEQUE_SIZE*workerDeques.size());
+    }
+
+    // pin workers to the CPUs of order, taken in turn (in NUMA mode
+    // among the ones of the node of each worker): if isolate_main, the
+    // first CPU is left to the worker of the main thread alone; must
+    // be called after set_numa_nodes() and before workers are created
+    void pin_workers(const std::vector<unsigned>& order, bool isolate_main) {
+        worker_cpus.clear();
+        if (order.empty()) {
+            return;
+        }
+        const std::vector<unsigned> shared(order.begin() + (isolate_main && order.size() > 1), order.end());
+        // workers already placed on each node
+        std::vector<std::size_t> placed(std::max<std::size_t>(1, numa_nodes.size()));
+        for (std::size_t w{}; w != worker_count; ++w) {
+            if (w == 0 && isolate_main) {
+                worker_cpus.push_back(order.front());
+                continue;
+            }
+            std::vector<unsigned> candidates;
+            if (!nodeChunkQueues.empty()) {
+                const auto& node_cpus = numa_nodes[node_of(w)].cpus;
+                std::copy_if(shared.begin(), shared.end(), std::back_inserter(candidates), [&](unsigned cpu){
+                    return std::find(node_cpus.begin(), node_cpus.end(), cpu) != node_cpus.end();
+                });
+            }
+            if (candidates.empty()) {
+                candidates = shared;
+            }
+            auto& n = placed[nodeChunkQueues.empty() ? 0 : node_of(w)];
+            worker_cpus.push_back(candidates[n++ % candidates.size()]);
+        }
+    }
+
+    // CPUs the given worker may run on, empty if any
+    std::vector<unsigned> cpus_of(std::size_t worker) const {
+        if (!worker_cpus.empty()) {
+            return {worker_cpus[worker]};
+        }
+        if (!nodeChunkQueues.empty()) {
+            return numa_nodes[node_of(worker)].cpus;
+        }
+        return {};
+    }
+
+    work_stealing::deque<chunk<T>>* worker_deque(std::size_t worker) const {
+        return workerDeques[worker].get();
+    }
+
+    // deques the given worker steals from: the ones of the
+    // workers on its node first, starting from the next one
+    std::vector<work_stealing::deque<chunk<T>>*> victims(std::size_t worker) const {
+        std::vector<work_stealing::deque<chunk<T>>*> ans;
+        const std::size_t n = workerDeques.size();
+        for (bool same_node : {true, false}) {
+            for (std::size_t i{1}; i < n; ++i) {
+                const std::size_t other = (worker + i) % n;
+                if ((node_of(other) == node_of(worker)) == same_node) {
+                    ans.push_back(workerDeques[other].get());
+                }
+            }
+        }
+        return ans;
+    }
+
+    // must be called before workers are created
+    void set_wait_options(const waiting::options& options) {
+        wait_options = options;
+    }
+
+    // some queue changed or some flag was set
+    void notify() {
+        activity.notify_all();
+    }
+
+    // must be called before any reader starts
+    void set_reader_count(unsigned int reader_count) {
+        this->reader_count = reader_count;
+    }
+
+    /* to be called once per reader, when all readers
+       have done no more input data will be generated */
     void set_end_of_input() {
-        end_of_input.store(true);
+        end_of_input.fetch_add(1);
+        notify();
     }
     bool test_end_of_input() {
-        return end_of_input.load();
+        return end_of_input.load() == reader_count;
     }
 
     // to be called once per worker to mark it will not
     // be able anymore to generate new chunks
     void set_end_of_str2num() {
         end_of_str2num.fetch_add(1);
+        notify();
     }
     // no more chunk will be generated
     bool test_end_of_str2num() const {
@@ -92,10 +366,21 @@ struct queues {
     // no more can be fetched)
     void set_end_of_analysis() {
         end_of_analysis.fetch_add(1);
+        notify();
     }
     bool test_end_of_analysis() const {
         return end_of_analysis.load() == worker_count;
     }
+
+    // called by a thread that cannot go on because of an error,
+    // other threads should stop as soon as possible
+    void set_aborted() {
+        aborted.store(true);
+        notify();
+    }
+    bool test_aborted() const {
+        return aborted.load();
+    }
 };
 
 
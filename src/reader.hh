@@ -5,78 +5,233 @@
 #include <memory>
 #include <vector>
 #include <string>
-#include <fstream>
+#include <string_view>
+#include <istream>
 #include <stdexcept>
 
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
-#include "../modules/CPP-csv-parser/csv.hh"
+#include "row_block.hh"
+#include "csv_scanner.hh"
+#include "decompressor.hh"
+#include "column_selection.hh"
 
 
 /**
  * @brief The reader is the component that will parse the input
  * and put the parsed strings in a queue to be extracted by the
- * converter to numeric types.
+ * converter to numeric types. Strings are sent in blocks of
+ * many rows (see row_block) to limit queue operations.
+ * Compressed input files are decompressed on the fly by a
+ * separate thread (see decompressor.hh).
+ *
+ * The input is read in large pieces appended to the text of the
+ * block being filled, and tokenized in place like mmap_reader does:
+ * fields are neither allocated nor copied one by one.
  */
 class reader {
 public:
     class end_of_inputs : public std::exception {};
+    // bytes of input read at once
+    static constexpr std::size_t READ_SIZE = 1 << 16;
 private:
     // name of the input file to be read
     std::string input_file;
-
-    csv::reader csv_in;
+    // decompressed input
+    std::unique_ptr<std::istream> in;
+    // number of columns, obtained from the header
+    std::size_t _column_count{};
+    // columns put in blocks, all by default
+    column_selection selection;
 
     // used to support smart memory management
-    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> row_queue_smart_ptr;
+    std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr;
     // the queue will be accessed by a row pointer allowing
     // this class to receive both smart and raw pointers 
-    lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>* row_queue_ptr;
+    lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr;
     // if data cannot be are maintained here
-    std::unique_ptr<std::vector<std::string>> holder;
-
-//    reader(std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> row_queue_smart_ptr)
-//    : row_queue_smart_ptr{std::move(row_queue_smart_ptr)}, row_queue_ptr{this->row_queue_smart_ptr.get()}
-//    {}
-//
-//    reader(lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>* row_queue_ptr)
-//    : row_queue_ptr{row_queue_ptr}
-//    {}
+    std::unique_ptr<row_block> holder;
+    // input read and not yet tokenized, the beginning of
+    // the text of the next block
+    std::string pending;
+    // end of file reached?
+    bool eof{};
+
+    // append the next piece of input to text,
+    // return false at the end of the file
+    bool read_more(std::string& text) {
+        if (eof) {
+            return false;
+        }
+        const std::size_t size = text.size();
+        text.resize(size + READ_SIZE);
+        in->read(&text[size], READ_SIZE);
+        text.resize(size + in->gcount());
+        if (!*in) {
+            if (in->bad()) {
+                throw std::runtime_error("Cannot read " + input_file);
+            }
+            eof = true;
+        }
+        return text.size() != size;
+    }
+
+    // the field between begin and its separator sep, quotes removed
+    static std::string_view field_at(const char* begin, const char* sep) {
+        const char* last = sep;
+        // handle CRLF line terminators
+        if (last != begin && last[-1] == '\r') {
+            --last;
+        }
+        if (begin != last && *begin == '"') {
+            if (last - begin < 2 || last[-1] != '"') {
+                throw std::runtime_error("Malformed quoted field");
+            }
+            ++begin;
+            --last;
+        }
+        return std::string_view(begin, last - begin);
+    }
+
+    // tokenize the row beginning at text[pos] passing its selected
+    // fields (all of them if columns is npos) to on_field, return
+    // the position after the row or npos if the row is not complete
+    // in text and the input is not over; scanner must scan text
+    template <typename F>
+    std::size_t next_row(const std::string& text, std::size_t pos, csv_scanner& scanner, std::size_t columns, F&& on_field) {
+        const char* const end = text.data() + text.size();
+        const char* cursor = text.data() + pos;
+        std::size_t fields{};
+        for (;;) {
+            const char* sep = scanner.next(cursor);
+            if (sep == end && !eof) {
+                return std::string::npos;
+            }
+            if (sep == end && scanner.unterminated()) {
+                throw std::runtime_error("Unterminated quoted field in " + input_file);
+            }
+            if (columns == std::string::npos || (fields < columns && selection.selected(fields))) {
+                on_field(field_at(cursor, sep));
+            }
+            ++fields;
+            if (sep == end || *sep == '\n') {
+                if (columns != std::string::npos && fields != columns) {
+                    using namespace std::literals;
+                    throw std::runtime_error("Row with "s + std::to_string(fields) + " fields instead of "s + std::to_string(columns));
+                }
+                return sep == end ? text.size() : sep + 1 - text.data();
+            }
+            cursor = sep + 1;
+        }
+    }
+
+    // tokenize rows from the beginning of text, passing their
+    // fields to on_field, until on_row returns false; input is
+    // appended to text as needed, the position after the last
+    // row is returned
+    template <typename F, typename R, typename D>
+    std::size_t tokenize(std::string& text, std::size_t columns, F&& on_field, R&& on_row, D&& on_discard) {
+        std::size_t pos{};
+        csv_scanner scanner(text.data(), text.data() + text.size());
+        for (;;) {
+            // skip empty lines
+            while (pos != text.size() && (text[pos] == '\n' || text[pos] == '\r')) ++pos;
+            std::size_t after = std::string::npos;
+            if (pos != text.size()) {
+                after = next_row(text, pos, scanner, columns, on_field);
+            }
+            if (after == std::string::npos) {
+                // views of the fields are no more valid once text grows
+                on_discard();
+                if (!read_more(text)) {
+                    return pos;
+                }
+                scanner = csv_scanner(text.data() + pos, text.data() + text.size());
+                continue;
+            }
+            pos = after;
+            if (!on_row()) {
+                return pos;
+            }
+        }
+    }
+
+    // get the column count from the header
+    void read_header() {
+        while (pending.size() < 3 && read_more(pending));
+        // skip UTF-8 BOM, if any
+        if (pending.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            pending.erase(0, 3);
+        }
+        const std::size_t after = tokenize(pending, std::string::npos,
+            [this](std::string_view){ ++_column_count; },
+            [](){ return false; },
+            [this](){ _column_count = 0; }
+        );
+        pending.erase(0, after);
+    }
+
+    // fill holder with rows until it is full or
+    // the end of file is reached
+    void fill_block() {
+        auto& text = holder->text();
+        const std::size_t after = tokenize(text, _column_count,
+            [this](std::string_view field){ holder->push_field(field); },
+            [this](){ holder->end_row(); return !holder->full(); },
+            [this](){ holder->discard_row(); }
+        );
+        // the rest is left for the next block
+        pending.assign(text, after, std::string::npos);
+        text.resize(after);
+    }
+
 public:
 
-    reader(std::string filename, std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>> row_queue_smart_ptr)
-    : input_file{std::move(filename)}, csv_in(std::unique_ptr<std::istream>(new std::ifstream(input_file))), row_queue_smart_ptr{std::move(row_queue_smart_ptr)}, row_queue_ptr{this->row_queue_smart_ptr.get()}
-    {}
+    // io selects how the input file is read (see async_input.hh)
+    reader(std::string filename, std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>> row_queue_smart_ptr, const async_io::options& io = {})
+    : reader(std::move(filename), row_queue_smart_ptr.get(), io)
+    {
+        this->row_queue_smart_ptr = std::move(row_queue_smart_ptr);
+    }
+
+    reader(std::string filename, lockfree_queue::fixed_size_lockfree_queue<row_block>* row_queue_ptr, const async_io::options& io = {})
+    : input_file{std::move(filename)}, in(compression::open(input_file, io)), row_queue_ptr{row_queue_ptr}
+    {
+        read_header();
+        selection = column_selection(_column_count);
+    }
 
-    reader(std::string filename, lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>* row_queue_ptr)
-    : input_file{std::move(filename)}, csv_in(std::unique_ptr<std::istream>(new std::ifstream(input_file))), row_queue_ptr{row_queue_ptr}
-    {}
+    // put in blocks only the given columns, to be
+    // called before reading
+    void select_columns(column_selection selection) {
+        if (selection.total() != _column_count) {
+            throw std::logic_error("Column selection does not match input columns");
+        }
+        this->selection = std::move(selection);
+    }
 
-    // consume a single row of the input and put
+    // consume a block of rows of the input and put
     // parsed data are enqueued in the queue
     // return true if data have been successfully inserted
     // return false if there are no more data to read
-    bool consume_row()
-    try
-    {
-        if (holder) {
-            return row_queue_ptr->offer(holder);    
+    bool consume_block() {
+        if (!holder) {
+            holder = std::make_unique<row_block>(std::move(pending), column_count(), row_block::default_rows(column_count()));
+            fill_block();
+            if (holder->empty()) {
+                holder.reset();
+                throw end_of_inputs{};
+            }
         }
-        auto line = csv_in.getline().access_and_invalidate();
-        holder = std::make_unique<std::vector<std::string>>(line);
         return row_queue_ptr->offer(holder);
     }
-    catch (csv::eof&)
-    {
-        throw end_of_inputs{};
-    }
 
-    // consume rows until the queue is full and the insertion fails
+    // consume blocks until the queue is full and the insertion fails
     // return true if end of input is reached and false if an
     // enqueeing is failed
     bool consume_many()
     try
     {
-        while (consume_row());
+        while (consume_block());
         return false;
     }
     catch (end_of_inputs&)
@@ -85,8 +240,9 @@ public:
     }
 
     // return the number of column in the given dataset
+    // (only the selected ones)
     std::size_t column_count() {
-        return csv_in.column_count();
+        return selection.size();
     }
 };
 
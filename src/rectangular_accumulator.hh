@@ -0,0 +1,141 @@
+
+#ifndef RECTANGULAR_ACCUMULATOR
+#define RECTANGULAR_ACCUMULATOR
+
+#include <vector>
+#include <valarray>
+#include <algorithm>
+
+#include "../modules/CPP-math-utils/correlation.hh"
+#include "aligned_buffer.hh"
+#include "pcc_kernels.hh"
+
+/**
+ * @brief Like math::statistics::multicolumn_pcc_accumulator, but only
+ * the sums of the products of the pairs in A x B are kept (see
+ * column_pairs): memory and work are proportional to |A|*|B| and not
+ * to the square of the number of columns.
+ *
+ * @tparam T numeric type to be used
+ */
+template <typename T>
+class rectangular_pcc_accumulator {
+    // columns of the chunks on each side
+    const std::vector<std::size_t> a, b;
+    // sums and sums of squares of each column of a and b
+    std::vector<T> sums_a, squares_a, sums_b, squares_b;
+    // sums of products, one row of b.size() items per column of a
+    std::vector<T> products;
+    // items of the columns of b in the row being processed
+    std::vector<T> row_b;
+    // first item of each column of a and b in the chunk being processed
+    std::vector<const T*> columns_a, columns_b;
+    // kernels for the CPU in use
+    const pcc_kernels::routines<T> kernels;
+    // rows accumulated
+    long long count{};
+
+    static void add_column(const T* x, std::size_t rows, std::size_t stride, T& sum, T& square) {
+        T s{}, q{};
+        for (std::size_t r{}; r != rows; ++r) {
+            const T v = x[r*stride];
+            s += v;
+            q += v*v;
+        }
+        sum += s;
+        square += q;
+    }
+
+    // columns are contiguous: products are dot products, computed
+    // by the kernels for the CPU in use (see pcc_kernels); if aligned
+    // columns start at a cache line and rows is a multiple of its
+    // items, they are read by aligned loads without a tail
+    void accumulate_by_columns(const T* data, std::size_t rows, std::size_t column_offset, bool aligned) {
+        for (std::size_t i{}; i != a.size(); ++i) {
+            columns_a[i] = data + a[i]*column_offset;
+        }
+        for (std::size_t j{}; j != b.size(); ++j) {
+            columns_b[j] = data + b[j]*column_offset;
+        }
+        kernels.dots(columns_a.data(), a.size(), columns_b.data(), b.size(), rows, products.data(), b.size(), aligned);
+    }
+
+    // any other layout: row by row, the items of b are gathered
+    // once per row so that the inner loop is contiguous
+    void accumulate_by_rows(const T* data, std::size_t rows, std::size_t row_offset, std::size_t column_offset) {
+        const std::size_t nb = b.size();
+        for (std::size_t r{}; r != rows; ++r) {
+            const T* const row = data + r*row_offset;
+            for (std::size_t j{}; j != nb; ++j) {
+                row_b[j] = row[b[j]*column_offset];
+            }
+            for (std::size_t i{}; i != a.size(); ++i) {
+                const T x = row[a[i]*column_offset];
+                T* const p = &products[i*nb];
+                for (std::size_t j{}; j != nb; ++j) {
+                    p[j] += x*row_b[j];
+                }
+            }
+        }
+    }
+
+public:
+    rectangular_pcc_accumulator(std::vector<std::size_t> a, std::vector<std::size_t> b,
+        pcc_kernels::routines<T> kernels = pcc_kernels::best<T>()
+    )
+    : a{std::move(a)}, b{std::move(b)},
+      sums_a(this->a.size()), squares_a(this->a.size()),
+      sums_b(this->b.size()), squares_b(this->b.size()),
+      products(this->a.size()*this->b.size()), row_b(this->b.size()),
+      columns_a(this->a.size()), columns_b(this->b.size()),
+      kernels{kernels}
+    {}
+
+    // add a (rows x cols) table whose item (r,c) is
+    // data[r*row_offset + c*column_offset]; items in the rows
+    // from rows to padded_rows, if larger, must be zeros and
+    // are processed as well when convenient (see chunk::zero_padding())
+    void accumulate(const T* data, std::size_t rows, std::size_t cols, std::size_t row_offset, std::size_t column_offset,
+        std::size_t padded_rows = 0
+    ) {
+        (void)cols;
+        for (std::size_t i{}; i != a.size(); ++i) {
+            add_column(data + a[i]*column_offset, rows, row_offset, sums_a[i], squares_a[i]);
+        }
+        for (std::size_t j{}; j != b.size(); ++j) {
+            add_column(data + b[j]*column_offset, rows, row_offset, sums_b[j], squares_b[j]);
+        }
+        constexpr std::size_t lanes = aligned_buffer::lanes<T>();
+        padded_rows = std::max(rows, padded_rows);
+        if (row_offset == 1 && padded_rows % lanes == 0 && column_offset % lanes == 0 && aligned_buffer::aligned(data)) {
+            // whole cache lines, without a scalar tail
+            accumulate_by_columns(data, padded_rows, column_offset, true);
+        } else if (row_offset == 1) {
+            accumulate_by_columns(data, rows, column_offset, false);
+        } else {
+            accumulate_by_rows(data, rows, row_offset, column_offset);
+        }
+        count += rows;
+    }
+
+    // partial results of each pair, in the order of column_pairs
+    std::valarray<math::statistics::pcc_partial<T>> to_pcc_partial_valarray() const {
+        std::valarray<math::statistics::pcc_partial<T>> ans(products.size());
+        std::size_t k{};
+        for (std::size_t i{}; i != a.size(); ++i) {
+            for (std::size_t j{}; j != b.size(); ++j, ++k) {
+                auto& p = ans[k];
+                p.sum_1 = sums_a[i];
+                p.sum_1_squared = squares_a[i];
+                p.sum_2 = sums_b[j];
+                p.sum_2_squared = squares_b[j];
+                p.sum_prod = products[k];
+                p.count = count;
+            }
+        }
+        return ans;
+    }
+};
+
+
+#endif
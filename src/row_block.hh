@@ -0,0 +1,147 @@
+
+#ifndef ROW_BLOCK
+#define ROW_BLOCK
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @brief A block of rows transmitted at once from readers to
+ * numeric parsers. Fields are not stored one by one: the block
+ * refers to a single buffer containing them all and it only holds
+ * the position of each field inside it.
+ * The buffer can be either owned by the block (fields are copied
+ * into it, or tokenized in place, see text()) or external (e.g. a
+ * mapped file), in the latter case it must outlive the block.
+ */
+class row_block {
+public:
+    // number of fields each block should contain, used
+    // to estimate how many rows to put in each block
+    static constexpr std::size_t DEFAULT_FIELDS = 1 << 14;
+
+    // default number of rows per block for the given column count
+    static std::size_t default_rows(std::size_t cols) {
+        return std::max<std::size_t>(1, DEFAULT_FIELDS / std::max<std::size_t>(1, cols));
+    }
+
+private:
+    // fields per row
+    const std::size_t _cols;
+    // maximum number of rows in the block
+    const std::size_t _max_rows;
+    // external buffer referred by the fields, nullptr if the
+    // buffer is owned by the block
+    const char* base{};
+    // buffer containing fields, used if base is nullptr
+    std::string storage;
+    // are fields views of storage instead of being copied?
+    const bool in_place{};
+    // for each field, the offsets (w.r.t. the buffer) of its
+    // first and one after its last char, row by row
+    std::vector<std::uint32_t> offsets;
+    // number of completed rows
+    std::size_t _rows{};
+
+    // beginning of the buffer fields refer to
+    const char* buffer() const {
+        return base ? base : storage.data();
+    }
+
+public:
+    // block copying fields in its own buffer
+    row_block(std::size_t cols, std::size_t max_rows)
+    : _cols{cols}, _max_rows{max_rows}
+    {
+        offsets.reserve(2*cols*max_rows);
+    }
+
+    // block referring to fields stored after base, only
+    // views to fields located after base can be inserted
+    row_block(const char* base, std::size_t cols, std::size_t max_rows)
+    : _cols{cols}, _max_rows{max_rows}, base{base}
+    {
+        offsets.reserve(2*cols*max_rows);
+    }
+
+    // block owning the given text, fields pushed must be
+    // views of text() taken after its last change
+    row_block(std::string text, std::size_t cols, std::size_t max_rows)
+    : _cols{cols}, _max_rows{max_rows}, storage{std::move(text)}, in_place{true}
+    {
+        offsets.reserve(2*cols*max_rows);
+    }
+
+    // the text of a block built from a text, input can be
+    // appended to be tokenized in place
+    std::string& text() {
+        return storage;
+    }
+
+    // append a field to the current row
+    void push_field(std::string_view field) {
+        std::size_t begin;
+        if (base || in_place) {
+            begin = field.data() - buffer();
+        } else {
+            begin = storage.size();
+            storage.append(field);
+        }
+        if (begin + field.size() > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("Row block too big");
+        }
+        offsets.push_back(begin);
+        offsets.push_back(begin + field.size());
+    }
+
+    // complete the current row, return the number of
+    // fields it contains: if they are not cols() the block
+    // is no more valid
+    std::size_t end_row() {
+        const auto fields = offsets.size()/2 - _rows*_cols;
+        ++_rows;
+        return fields;
+    }
+
+    // remove the fields of the current row, not yet completed
+    void discard_row() {
+        offsets.resize(2*_rows*_cols);
+    }
+
+    // get the field in the given position
+    std::string_view field(std::size_t row, std::size_t col) const {
+        const auto idx = 2*(row*_cols + col);
+        return std::string_view(buffer() + offsets[idx], offsets[idx+1] - offsets[idx]);
+    }
+
+    // number of completed rows
+    std::size_t rows() const {
+        return _rows;
+    }
+
+    // maximum number of rows this block can contain
+    std::size_t max_rows() const {
+        return _max_rows;
+    }
+
+    // number of fields per row
+    std::size_t cols() const {
+        return _cols;
+    }
+
+    bool empty() const {
+        return _rows == 0;
+    }
+
+    bool full() const {
+        return _rows == _max_rows;
+    }
+};
+
+
+#endif
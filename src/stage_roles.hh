@@ -0,0 +1,131 @@
+
+#ifndef STAGE_ROLES
+#define STAGE_ROLES
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Roles of the workers when parsing and analysing are done by
+ * separate pools (--roles): a worker with a role performs only the
+ * tasks of its stage while the input is being read, the controller
+ * moves workers between pools (see controller.hh).
+ *
+ * The queues do not tell how many items they hold, so their fill
+ * levels are seen through the workers: parsers report when they find
+ * no rows (row queue empty) or cannot store chunks (chunk queues
+ * full), analysers when they find no chunk (chunk queues empty).
+ */
+namespace stage_roles {
+
+    enum class role : unsigned char {
+        // parse or analyse, as chosen by the worker
+        any,
+        parse,
+        compute
+    };
+
+    // a deque filled less than this is almost empty, more than
+    // (1 - LOW_BACKLOG) almost full
+    constexpr double LOW_BACKLOG = .25;
+
+    // what workers saw in a period
+    struct sample {
+        std::uint64_t rows_missing{};
+        std::uint64_t chunks_blocked{};
+        std::uint64_t chunks_missing{};
+        // chunks waiting in the deques of the workers, over their capacity
+        double backlog{};
+    };
+
+    // pool that needs a worker more, any if balanced: the one starving
+    // downstream when the other one is not
+    inline role needed(const sample& s) {
+        const bool analysers_idle = s.chunks_missing && s.backlog < LOW_BACKLOG;
+        const bool parsers_idle = s.rows_missing || s.chunks_blocked || s.backlog > 1 - LOW_BACKLOG;
+        if (analysers_idle && !parsers_idle) {
+            return role::parse;
+        }
+        if (parsers_idle && !analysers_idle) {
+            return role::compute;
+        }
+        return role::any;
+    }
+
+    /**
+     * @brief Role of each worker and events reported by them, the
+     * worker of the main thread (0) also reads and has no role.
+     */
+    class assignment {
+        std::vector<std::atomic<role>> roles;
+        std::atomic<std::uint64_t> rows_missing{}, chunks_blocked{}, chunks_missing{};
+
+    public:
+        // the first parsers workers after the main one parse, the others analyse
+        assignment(std::size_t workers, std::size_t parsers)
+        : roles(workers)
+        {
+            for (std::size_t w{1}; w < workers; ++w) {
+                roles[w].store(w <= parsers ? role::parse : role::compute, std::memory_order_relaxed);
+            }
+        }
+
+        role of(std::size_t worker) const {
+            return roles[worker].load(std::memory_order_relaxed);
+        }
+
+        std::size_t count(role r) const {
+            std::size_t ans{};
+            for (const auto& w : roles) {
+                ans += w.load(std::memory_order_relaxed) == r;
+            }
+            return ans;
+        }
+
+        // give a worker of from the role to, keeping at least
+        // a worker in each pool
+        bool move(role from, role to) {
+            if (count(from) < 2) {
+                return false;
+            }
+            for (auto it = roles.rbegin(); it != roles.rend(); ++it) {
+                if (it->load(std::memory_order_relaxed) == from) {
+                    it->store(to, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // all the workers perform all the tasks
+        void clear() {
+            for (auto& w : roles) {
+                w.store(role::any, std::memory_order_relaxed);
+            }
+        }
+
+        void report_rows_missing() {
+            rows_missing.fetch_add(1, std::memory_order_relaxed);
+        }
+        void report_chunks_blocked() {
+            chunks_blocked.fetch_add(1, std::memory_order_relaxed);
+        }
+        void report_chunks_missing() {
+            chunks_missing.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // events since the last call
+        sample take(double backlog) {
+            sample ans;
+            ans.rows_missing = rows_missing.exchange(0, std::memory_order_relaxed);
+            ans.chunks_blocked = chunks_blocked.exchange(0, std::memory_order_relaxed);
+            ans.chunks_missing = chunks_missing.exchange(0, std::memory_order_relaxed);
+            ans.backlog = backlog;
+            return ans;
+        }
+    };
+}
+
+
+#endif
@@ -0,0 +1,239 @@
+
+#ifndef TOPOLOGY
+#define TOPOLOGY
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * @brief Layout of the CPUs of the machine as described by Linux in
+ * sysfs, used to place threads and memory: on machines with many NUMA
+ * nodes each worker runs on the CPUs of a single node and data it
+ * allocates is placed on that node (pages are mapped on the node of
+ * the thread touching them first).
+ *
+ * Threads can also be pinned each to a single CPU (see
+ * placement_order()), keeping threads on different physical cores as
+ * long as possible or, on the contrary, on the same ones.
+ *
+ * Without sysfs the machine is seen as a single node holding all
+ * the CPUs, each one a core on its own.
+ */
+namespace topology {
+
+    // a NUMA node and the CPUs it holds
+    struct node {
+        unsigned id{};
+        std::vector<unsigned> cpus;
+    };
+
+    // parse a list of CPUs in the format of sysfs (and taskset),
+    // e.g. 0-3,8,10-11, malformed items are ignored
+    inline std::vector<unsigned> parse_cpu_list(const std::string& list) {
+        std::vector<unsigned> ans;
+        std::size_t begin{};
+        while (begin < list.size()) {
+            std::size_t end = list.find(',', begin);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            const std::string item = list.substr(begin, end - begin);
+            begin = end + 1;
+            try {
+                const std::size_t dash = item.find('-');
+                const unsigned first = std::stoul(item.substr(0, dash));
+                const unsigned last = dash == std::string::npos ? first : std::stoul(item.substr(dash + 1));
+                for (unsigned cpu{first}; cpu <= last; ++cpu) {
+                    ans.push_back(cpu);
+                }
+            } catch (const std::exception&) {
+                // e.g. empty list or trailing newline
+            }
+        }
+        return ans;
+    }
+
+    // first line of a sysfs file, empty if missing
+    inline std::string read_line(const std::string& path) {
+        std::ifstream file(path);
+        std::string ans;
+        std::getline(file, ans);
+        return ans;
+    }
+
+    // NUMA nodes with at least a CPU, by id
+    inline std::vector<node> nodes() {
+        const std::string root = "/sys/devices/system/node/";
+        std::vector<node> ans;
+        for (unsigned id : parse_cpu_list(read_line(root + "online"))) {
+            node n{id, parse_cpu_list(read_line(root + "node" + std::to_string(id) + "/cpulist"))};
+            if (!n.cpus.empty()) {
+                ans.push_back(std::move(n));
+            }
+        }
+        if (ans.empty()) {
+            node all;
+            for (unsigned cpu{}; cpu != std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+                all.cpus.push_back(cpu);
+            }
+            ans.push_back(std::move(all));
+        }
+        return ans;
+    }
+
+    // sizes in bytes of the caches seen by a core
+    struct cache_sizes {
+        std::size_t l1d = 32 << 10;
+        std::size_t l2 = 1 << 20;
+        // last level, usually shared by the cores of a socket
+        std::size_t llc = 8 << 20;
+    };
+
+    // parse a size in the format of sysfs, e.g. 48K, 0 if malformed
+    inline std::size_t parse_size(const std::string& size) {
+        try {
+            std::size_t end{};
+            std::size_t ans = std::stoul(size, &end);
+            if (end < size.size()) {
+                switch (size[end]) {
+                case 'K': ans <<= 10; break;
+                case 'M': ans <<= 20; break;
+                case 'G': ans <<= 30; break;
+                }
+            }
+            return ans;
+        } catch (const std::exception&) {
+            return 0;
+        }
+    }
+
+    // caches of the first CPU, the ones not described
+    // in sysfs keep a typical size
+    inline cache_sizes caches() {
+        const std::string root = "/sys/devices/system/cpu/cpu0/cache/index";
+        cache_sizes ans;
+        std::size_t llc_level{};
+        for (unsigned i{};; ++i) {
+            const std::string dir = root + std::to_string(i) + "/";
+            const std::string level = read_line(dir + "level");
+            if (level.empty()) {
+                break;
+            }
+            const std::size_t size = parse_size(read_line(dir + "size"));
+            if (!size || read_line(dir + "type") == "Instruction") {
+                continue;
+            }
+            if (level == "1") {
+                ans.l1d = size;
+            } else if (level == "2") {
+                ans.l2 = size;
+            }
+            if (std::stoul(level) >= std::max<std::size_t>(llc_level, 2)) {
+                llc_level = std::stoul(level);
+                ans.llc = size;
+            }
+        }
+        return ans;
+    }
+
+    // a logical CPU and the physical core it belongs to,
+    // CPUs of the same core share its execution units (SMT)
+    struct cpu {
+        unsigned id{};
+        unsigned core{};
+        unsigned package{};
+    };
+
+    // online CPUs, by id
+    inline std::vector<cpu> cpus() {
+        const std::string root = "/sys/devices/system/cpu/";
+        std::vector<cpu> ans;
+        auto ids = parse_cpu_list(read_line(root + "online"));
+        if (ids.empty()) {
+            for (unsigned id{}; id != std::max(1u, std::thread::hardware_concurrency()); ++id) {
+                ids.push_back(id);
+            }
+        }
+        for (const unsigned id : ids) {
+            const std::string dir = root + "cpu" + std::to_string(id) + "/topology/";
+            cpu c{id, id, 0};
+            try {
+                c.core = std::stoul(read_line(dir + "core_id"));
+                c.package = std::stoul(read_line(dir + "physical_package_id"));
+            } catch (const std::exception&) {
+                // no topology: each CPU is a core
+            }
+            ans.push_back(c);
+        }
+        return ans;
+    }
+
+    // how threads are placed on the CPUs of the same core
+    enum class smt {
+        // a thread per core, as long as there are free cores
+        avoid,
+        // fill all the CPUs of a core before the next one
+        pack
+    };
+
+    // the given CPUs in the order threads should take them
+    inline std::vector<unsigned> placement_order(std::vector<cpu> cpus, smt policy) {
+        // position of each CPU among the ones of its core
+        std::vector<std::pair<std::size_t, cpu>> ranked;
+        for (const auto& c : cpus) {
+            const auto sibling = std::count_if(ranked.begin(), ranked.end(), [&](const auto& r){
+                return r.second.package == c.package && r.second.core == c.core;
+            });
+            ranked.emplace_back(sibling, c);
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [policy](const auto& a, const auto& b){
+            const auto key = [policy](const auto& r){
+                return policy == smt::avoid
+                    ? std::make_tuple(r.first, r.second.package, r.second.core)
+                    : std::make_tuple(std::size_t{}, r.second.package, r.second.core);
+            };
+            return key(a) < key(b);
+        });
+        std::vector<unsigned> ans;
+        for (const auto& r : ranked) {
+            ans.push_back(r.second.id);
+        }
+        return ans;
+    }
+
+    // the given CPUs but the ones sharing a core with cpu
+    inline std::vector<cpu> without_core_of(const std::vector<cpu>& cpus, unsigned id) {
+        const auto it = std::find_if(cpus.begin(), cpus.end(), [id](const cpu& c){ return c.id == id; });
+        std::vector<cpu> ans;
+        for (const auto& c : cpus) {
+            if (it == cpus.end() ? c.id != id : (c.package != it->package || c.core != it->core)) {
+                ans.push_back(c);
+            }
+        }
+        return ans;
+    }
+
+    // let the calling thread run only on the given CPUs,
+    // return false if not allowed (e.g. CPUs not available)
+    inline bool bind(const std::vector<unsigned>& cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto cpu : cpus) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+    }
+}
+
+
+#endif
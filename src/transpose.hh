@@ -0,0 +1,172 @@
+
+#ifndef TRANSPOSE
+#define TRANSPOSE
+
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "cpu_features.hh"
+
+#ifdef X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Copy tables between the row and the column layout (see
+ * chunk_layout). The table is split into square tiles small enough
+ * for a tile of the source and one of the destination to stay in L1
+ * together, so that both are read and written by whole cache lines.
+ * Inside each tile, blocks of 4x4 doubles or 8x8 floats are
+ * transposed in registers with AVX2 when the CPU supports it.
+ */
+namespace transpose {
+
+    // side of the tiles, a multiple of the register blocks
+    constexpr std::size_t TILE = 32;
+
+    // routine storing in b[j*ldb + i] the item a[i*lda + j]
+    // of a (rows x cols) table a
+    template <typename T>
+    using routine = void (*)(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols);
+
+    // one item at a time, no tiles, for reference
+    template <typename T>
+    void naive(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols) {
+        for (std::size_t i{}; i != rows; ++i) {
+            for (std::size_t j{}; j != cols; ++j) {
+                b[j*ldb + i] = a[i*lda + j];
+            }
+        }
+    }
+
+    // tile by tile, block_size x block_size blocks are transposed
+    // by block, the rest of each tile one item at a time
+    template <typename T, std::size_t block_size, typename B>
+    __attribute__((always_inline)) inline void tiled(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols, B&& block) {
+        for (std::size_t ib{}; ib < rows; ib += TILE) {
+            const std::size_t ie = std::min(rows, ib + TILE);
+            for (std::size_t jb{}; jb < cols; jb += TILE) {
+                const std::size_t je = std::min(cols, jb + TILE);
+                // blocks fully inside the tile
+                const std::size_t ibe = ib + (ie - ib) / block_size * block_size;
+                const std::size_t jbe = jb + (je - jb) / block_size * block_size;
+                for (std::size_t i{ib}; i != ibe; i += block_size) {
+                    for (std::size_t j{jb}; j != jbe; j += block_size) {
+                        block(a + i*lda + j, lda, b + j*ldb + i, ldb);
+                    }
+                    for (std::size_t r{i}; r != i + block_size; ++r) {
+                        for (std::size_t j{jbe}; j != je; ++j) {
+                            b[j*ldb + r] = a[r*lda + j];
+                        }
+                    }
+                }
+                for (std::size_t i{ibe}; i != ie; ++i) {
+                    for (std::size_t j{jb}; j != je; ++j) {
+                        b[j*ldb + i] = a[i*lda + j];
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    void scalar(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols) {
+        tiled<T, 1>(a, lda, b, ldb, rows, cols, [](const T* a, std::size_t, T* b, std::size_t){
+            *b = *a;
+        });
+    }
+
+#ifdef X86_SIMD
+    __attribute__((target("avx2"), flatten))
+    inline void avx2(const double* a, std::size_t lda, double* b, std::size_t ldb, std::size_t rows, std::size_t cols) {
+        tiled<double, 4>(a, lda, b, ldb, rows, cols, [](const double* a, std::size_t lda, double* b, std::size_t ldb) __attribute__((target("avx2"))) {
+            const __m256d r0 = _mm256_loadu_pd(a);
+            const __m256d r1 = _mm256_loadu_pd(a + lda);
+            const __m256d r2 = _mm256_loadu_pd(a + 2*lda);
+            const __m256d r3 = _mm256_loadu_pd(a + 3*lda);
+            // a00 a10 a02 a12, a01 a11 a03 a13, ...
+            const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+            const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+            const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+            const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+            _mm256_storeu_pd(b, _mm256_permute2f128_pd(t0, t2, 0x20));
+            _mm256_storeu_pd(b + ldb, _mm256_permute2f128_pd(t1, t3, 0x20));
+            _mm256_storeu_pd(b + 2*ldb, _mm256_permute2f128_pd(t0, t2, 0x31));
+            _mm256_storeu_pd(b + 3*ldb, _mm256_permute2f128_pd(t1, t3, 0x31));
+        });
+    }
+
+    __attribute__((target("avx2"), flatten))
+    inline void avx2(const float* a, std::size_t lda, float* b, std::size_t ldb, std::size_t rows, std::size_t cols) {
+        tiled<float, 8>(a, lda, b, ldb, rows, cols, [](const float* a, std::size_t lda, float* b, std::size_t ldb) __attribute__((target("avx2"))) {
+            __m256 r[8], t[8];
+            for (std::size_t i{}; i != 8; ++i) {
+                r[i] = _mm256_loadu_ps(a + i*lda);
+            }
+            // interleave pairs of rows, then quadruples
+            for (std::size_t i{}; i != 8; i += 2) {
+                t[i] = _mm256_unpacklo_ps(r[i], r[i+1]);
+                t[i+1] = _mm256_unpackhi_ps(r[i], r[i+1]);
+            }
+            for (std::size_t i{}; i != 8; i += 4) {
+                r[i] = _mm256_shuffle_ps(t[i], t[i+2], _MM_SHUFFLE(1,0,1,0));
+                r[i+1] = _mm256_shuffle_ps(t[i], t[i+2], _MM_SHUFFLE(3,2,3,2));
+                r[i+2] = _mm256_shuffle_ps(t[i+1], t[i+3], _MM_SHUFFLE(1,0,1,0));
+                r[i+3] = _mm256_shuffle_ps(t[i+1], t[i+3], _MM_SHUFFLE(3,2,3,2));
+            }
+            // low halves come from the first four rows
+            for (std::size_t i{}; i != 4; ++i) {
+                _mm256_storeu_ps(b + i*ldb, _mm256_permute2f128_ps(r[i], r[i+4], 0x20));
+                _mm256_storeu_ps(b + (i+4)*ldb, _mm256_permute2f128_ps(r[i], r[i+4], 0x31));
+            }
+        });
+    }
+#endif
+
+    // best routine supported by the CPU for T
+    template <typename T>
+    routine<T> best_routine() {
+#ifdef X86_SIMD
+        if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+            static const routine<T> best = cpu_features::has_avx2() ? static_cast<routine<T>>(avx2) : scalar<T>;
+            return best;
+        }
+#endif
+        return scalar<T>;
+    }
+
+    // copy a (rows x cols) table whose item (r,c) is
+    // src[r*src_row_offset + c*src_column_offset] into dst,
+    // where it is stored at dst[r*dst_row_offset + c*dst_column_offset]
+    template <typename T>
+    void copy(const T* src, std::size_t src_row_offset, std::size_t src_column_offset,
+        T* dst, std::size_t dst_row_offset, std::size_t dst_column_offset,
+        std::size_t rows, std::size_t cols
+    ) {
+        if (src_column_offset == 1 && dst_row_offset == 1) {
+            // by rows to by columns
+            best_routine<T>()(src, src_row_offset, dst, dst_column_offset, rows, cols);
+        } else if (src_row_offset == 1 && dst_column_offset == 1) {
+            // by columns to by rows
+            best_routine<T>()(src, src_column_offset, dst, dst_row_offset, cols, rows);
+        } else if (src_column_offset == 1 && dst_column_offset == 1) {
+            for (std::size_t r{}; r != rows; ++r) {
+                std::memcpy(dst + r*dst_row_offset, src + r*src_row_offset, cols*sizeof(T));
+            }
+        } else if (src_row_offset == 1 && dst_row_offset == 1) {
+            for (std::size_t c{}; c != cols; ++c) {
+                std::memcpy(dst + c*dst_column_offset, src + c*src_column_offset, rows*sizeof(T));
+            }
+        } else {
+            for (std::size_t r{}; r != rows; ++r) {
+                for (std::size_t c{}; c != cols; ++c) {
+                    dst[r*dst_row_offset + c*dst_column_offset] = src[r*src_row_offset + c*src_column_offset];
+                }
+            }
+        }
+    }
+}
+
+
+#endif
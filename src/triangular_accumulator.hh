@@ -0,0 +1,149 @@
+#ifndef TRIANGULAR_ACCUMULATOR
+#define TRIANGULAR_ACCUMULATOR
+
+#include <vector>
+#include <valarray>
+#include <algorithm>
+#include <utility>
+
+#include "../modules/CPP-math-utils/correlation.hh"
+#include "column_pairs.hh"
+#include "pcc_kernels.hh"
+#include "topology.hh"
+
+/**
+ * @brief Like math::statistics::multicolumn_pcc_accumulator, but the
+ * sums of the products of all the pairs are updated as a symmetric
+ * rank-k update of a BLAS (SYRK): a chunk X adds XᵀX to them.
+ *
+ * Updating every pair at every row streams all the partial results
+ * through the caches once per row: with thousands of columns they do
+ * not fit in L2 and the analysis is bound by memory bandwidth. Here
+ * rows are taken in blocks of BLOCK_ROWS and columns in blocks whose
+ * items of a row block fit in half of L2; each block of MR x NR sums
+ * is kept in registers while the rows of the block are scanned, so
+ * that every partial result is read and written once per row block
+ * and every item is loaded once per MR or NR sums it contributes to.
+ * Kernels use the widest SIMD registers of the CPU (see pcc_kernels).
+ *
+ * @tparam T numeric type to be used
+ */
+template <typename T>
+class triangular_pcc_accumulator {
+public:
+    // rows added to the sums in registers before storing them: the
+    // items of a block of sums (BLOCK_ROWS x (MR+NR)) stay in L1
+    static constexpr std::size_t BLOCK_ROWS = 256;
+
+private:
+    const std::size_t cols;
+    // kernels for the CPU in use
+    const pcc_kernels::routines<T> kernels;
+    // columns of the blocks of items kept in L2
+    const std::size_t block_cols;
+    // sums and sums of squares of each column
+    std::vector<T> sums, squares;
+    // sums of products, pairs (i,j) with i < j in the order
+    // of column_pairs: the ones of i are contiguous
+    std::vector<T> products;
+    // index in products of the pair (i,i+1)
+    std::vector<std::size_t> starts;
+    // rows accumulated
+    long long count{};
+
+public:
+    triangular_pcc_accumulator(std::size_t cols, std::size_t l2 = topology::caches().l2,
+        pcc_kernels::routines<T> kernels = pcc_kernels::best<T>()
+    )
+    : cols{cols},
+      kernels{kernels},
+      block_cols{std::max(kernels.width, l2/2/(BLOCK_ROWS*sizeof(T))/kernels.width*kernels.width)},
+      sums(cols), squares(cols),
+      products(cols*(std::max<std::size_t>(cols, 1)-1)/2), starts(cols)
+    {
+        for (std::size_t i{1}; i < cols; ++i) {
+            starts[i] = starts[i-1] + cols - i;
+        }
+    }
+
+    // add a (rows x cols) table whose item (r,c) is
+    // data[r*row_offset + c*column_offset]; the blocked
+    // kernel needs rows to be contiguous (column_offset 1)
+    void accumulate(const T* data, std::size_t rows, std::size_t cols, std::size_t row_offset, std::size_t column_offset) {
+        (void)cols;
+        accumulate_rows(data, rows, row_offset, column_offset, 0, this->cols, true);
+    }
+
+    // as accumulate(), but only the pairs (i,j) with i in [ib, ie)
+    // (rows of the triangle of pairs), with the sums of the columns
+    // and the rows of the table only if totals; tables split among
+    // accumulators must be added with totals by one of them
+    void accumulate_rows(const T* data, std::size_t rows, std::size_t row_offset, std::size_t column_offset,
+        std::size_t ib, std::size_t ie, bool totals
+    ) {
+        for (std::size_t rb{}; rb < rows; rb += BLOCK_ROWS) {
+            const std::size_t n = std::min(BLOCK_ROWS, rows - rb);
+            const T* const x = data + rb*row_offset;
+            if (column_offset != 1) {
+                for (std::size_t r{}; totals && r != n; ++r) {
+                    for (std::size_t c{}; c != cols; ++c) {
+                        const T v = x[r*row_offset + c*column_offset];
+                        sums[c] += v;
+                        squares[c] += v*v;
+                    }
+                }
+                for (std::size_t i{ib}; i < ie; ++i) {
+                    pcc_kernels::pairs(x, n, row_offset, column_offset, i, i + 1, cols, products.data(), starts.data());
+                }
+                continue;
+            }
+            if (totals) {
+                kernels.sums(x, n, row_offset, cols, sums.data(), squares.data());
+            }
+            // columns j before ib + 1 have no pair with the rows
+            for (std::size_t jb{ib + 1 - (ib + 1) % block_cols}; jb < cols; jb += block_cols) {
+                kernels.products(x, n, row_offset, ib, ie, jb, std::min(cols, jb + block_cols), products.data(), starts.data());
+            }
+        }
+        if (totals) {
+            count += rows;
+        }
+    }
+
+    // rows of the triangle of pairs [ib, ie) of the given tile when
+    // split in tiles of about the same number of pairs
+    std::pair<std::size_t, std::size_t> tile_rows(std::size_t tile, std::size_t tiles) const {
+        const auto first_row = [this, tiles](std::size_t t) -> std::size_t {
+            if (t == 0 || products.empty()) {
+                return 0;
+            }
+            if (t >= tiles) {
+                return cols;
+            }
+            // the row of the first pair of the tile, whole
+            return column_pairs::pair_at(cols, products.size()*t/tiles).first;
+        };
+        return {first_row(tile), first_row(tile + 1)};
+    }
+
+    // partial results of each pair, in the order of column_pairs
+    std::valarray<math::statistics::pcc_partial<T>> to_pcc_partial_valarray() const {
+        std::valarray<math::statistics::pcc_partial<T>> ans(products.size());
+        std::size_t k{};
+        for (std::size_t i{}; i + 1 < cols; ++i) {
+            for (std::size_t j{i+1}; j != cols; ++j, ++k) {
+                auto& p = ans[k];
+                p.sum_1 = sums[i];
+                p.sum_1_squared = squares[i];
+                p.sum_2 = sums[j];
+                p.sum_2_squared = squares[j];
+                p.sum_prod = products[k];
+                p.count = count;
+            }
+        }
+        return ans;
+    }
+};
+
+
+#endif
@@ -0,0 +1,168 @@
+
+#ifndef WAIT_STRATEGY
+#define WAIT_STRATEGY
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+/**
+ * What a thread does when it finds nothing to do (e.g. row and chunk
+ * queues empty): spinning keeps the latency low but burns a core, so
+ * after a budget of spins threads park in the kernel until another
+ * thread signals some progress (see eventcount).
+ */
+namespace waiting {
+
+    enum class strategy {
+        // poll again immediately (the original behaviour)
+        spin,
+        // give up the time slice at each stall
+        yield,
+        // spin, then yield, then sleep until notified
+        park
+    };
+
+    struct options {
+#ifdef YIELD
+#pragma message "Yield processor if thread 'stalls'..."
+        strategy policy = strategy::yield;
+#else
+        strategy policy = strategy::park;
+#endif
+        // failed iterations spent spinning before parking
+        unsigned spins = 1000;
+        // then failed iterations spent yielding
+        unsigned yields = 10;
+        // bound on each sleep, in case a notification is missed
+        std::chrono::microseconds max_park{1000};
+    };
+
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    /**
+     * @brief Threads wait for a change of epoch, incremented by
+     * notify_all() only if some thread is waiting: notifications are
+     * cheap when nobody sleeps. A waiter calls prepare_wait(), checks
+     * again whether there is something to do, then either calls
+     * cancel_wait() or wait() with the epoch read before checking,
+     * so notifications in between are not lost.
+     */
+    class eventcount {
+        std::atomic<std::uint32_t> epoch{};
+        std::atomic<std::uint32_t> waiters{};
+
+    public:
+        std::uint32_t prepare_wait() {
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            return epoch.load(std::memory_order_seq_cst);
+        }
+
+        void cancel_wait() {
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // sleep until epoch changes from key, at most timeout
+        void wait(std::uint32_t key, std::chrono::microseconds timeout) {
+#ifdef __linux__
+            const auto s = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+            timespec ts{static_cast<std::time_t>(s.count()), static_cast<long>((timeout - s).count()*1000)};
+            ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, key, &ts, nullptr, 0);
+#else
+            if (epoch.load(std::memory_order_acquire) == key) {
+                std::this_thread::sleep_for(timeout);
+            }
+#endif
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // wake all the waiting threads, if any
+        void notify_all() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed)) {
+                epoch.fetch_add(1, std::memory_order_seq_cst);
+#ifdef __linux__
+                ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+            }
+        }
+    };
+
+    /**
+     * @brief State of a thread that may stall, each of its iterations
+     * looking for work must be enclosed by before() and after(): once
+     * the budgets of spins and yields are spent, before() registers
+     * the thread as waiting, so progress made by other threads while
+     * it looks for work is not missed, and after() parks it if it
+     * found nothing.
+     */
+    class waiter {
+        const options opts;
+        eventcount& events;
+        // consecutive stalled iterations
+        unsigned stalls{};
+        // registered as waiting by before()
+        bool armed{};
+        std::uint32_t key{};
+
+    public:
+        waiter(const options& opts, eventcount& events)
+        : opts{opts}, events{events}
+        {}
+
+        void before() {
+            armed = opts.policy == strategy::park && parking();
+            if (armed) {
+                key = events.prepare_wait();
+            }
+        }
+
+        // progress: did the iteration do something?
+        void after(bool progress) {
+            if (progress) {
+                stalls = 0;
+                if (armed) {
+                    events.cancel_wait();
+                }
+                return;
+            }
+            switch (opts.policy) {
+            case strategy::spin:
+                return;
+            case strategy::yield:
+                std::this_thread::yield();
+                return;
+            case strategy::park:
+                break;
+            }
+            if (armed) {
+                events.wait(key, opts.max_park);
+            } else if (++stalls <= opts.spins) {
+                cpu_relax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        // is the thread going to park at the next stall?
+        bool parking() const {
+            return stalls >= opts.spins + opts.yields;
+        }
+    };
+}
+
+
+#endif
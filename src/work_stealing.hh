@@ -0,0 +1,197 @@
+
+#ifndef WORK_STEALING
+#define WORK_STEALING
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * @brief Each worker keeps the chunks it parses in its own deque and
+ * analyses the last one first, likely still in its caches; workers
+ * finding nothing to do steal the oldest chunks of the others.
+ *
+ * A worker chooses its next task looking at its own deque: while it
+ * is empty analysers downstream are starving and parsing comes first,
+ * otherwise analysing comes first. Stages are then balanced by the
+ * chunks actually waiting instead of by a fixed share of repetitions.
+ */
+namespace work_stealing {
+
+    // chunks waiting in the deque of each worker
+    constexpr std::size_t DEQUE_SIZE = 4;
+
+    enum class task {
+        parse,
+        compute
+    };
+
+    // synchronizations on the deques, to see how much
+    // workers contend for them
+    struct counters {
+        // locks taken
+        std::uint64_t locks{};
+        // locks found already taken by another thread
+        std::uint64_t contended{};
+        // successful steals and items they took
+        std::uint64_t steals{};
+        std::uint64_t stolen{};
+
+        counters& operator+=(const counters& other) {
+            locks += other.locks;
+            contended += other.contended;
+            steals += other.steals;
+            stolen += other.stolen;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Bounded deque of owned items: the owner pushes and pops
+     * at the back, thieves take from the front, up to half of the
+     * items at once. Critical sections are a few instructions long
+     * and thieves are rare, a lock is enough. Each deque has its own
+     * cache lines, not to be disturbed by the ones of other workers.
+     */
+    template <typename T>
+    class alignas(64) deque {
+        const std::size_t capacity;
+        std::deque<std::unique_ptr<T>> items;
+        mutable std::mutex lock;
+        // read by the owner without locking
+        std::atomic_size_t _size{};
+        // see counters, updated while holding the lock
+        std::atomic<std::uint64_t> locks{}, contended{}, steals{}, stolen{};
+
+        std::unique_lock<std::mutex> acquire() {
+            std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+            if (!guard.owns_lock()) {
+                contended.fetch_add(1, std::memory_order_relaxed);
+                guard.lock();
+            }
+            locks.store(locks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return guard;
+        }
+
+        void update_size() {
+            _size.store(items.size(), std::memory_order_relaxed);
+        }
+
+    public:
+        deque(std::size_t capacity = DEQUE_SIZE)
+        : capacity{capacity}
+        {}
+
+        deque(const deque&) = delete;
+        deque& operator=(const deque&) = delete;
+
+        // by the owner, item is moved only on success
+        bool push(std::unique_ptr<T>& item) {
+            // cheap check, only thieves make room
+            if (size() == capacity) {
+                return false;
+            }
+            const auto guard = acquire();
+            if (items.size() == capacity) {
+                return false;
+            }
+            items.push_back(std::move(item));
+            update_size();
+            return true;
+        }
+
+        // by the owner, push the first items that fit with a single
+        // synchronization, they are removed from the vector
+        std::size_t push_many(std::vector<std::unique_ptr<T>>& batch) {
+            if (batch.empty() || size() == capacity) {
+                return 0;
+            }
+            const auto guard = acquire();
+            const std::size_t n = std::min(batch.size(), capacity - items.size());
+            for (std::size_t i{}; i != n; ++i) {
+                items.push_back(std::move(batch[i]));
+            }
+            batch.erase(batch.begin(), batch.begin() + n);
+            update_size();
+            return n;
+        }
+
+        // by the owner, the last item pushed
+        bool pop(std::unique_ptr<T>& item) {
+            // cheap check, nobody else pushes
+            if (!size()) {
+                return false;
+            }
+            const auto guard = acquire();
+            if (items.empty()) {
+                return false;
+            }
+            item = std::move(items.back());
+            items.pop_back();
+            update_size();
+            return true;
+        }
+
+        // by thieves, the first half of the items (at least one)
+        // with a single synchronization, appended to batch
+        std::size_t steal_many(std::vector<std::unique_ptr<T>>& batch) {
+            // cheap check, not to disturb the owner
+            if (!size()) {
+                return 0;
+            }
+            const auto guard = acquire();
+            const std::size_t n = (items.size() + 1)/2;
+            for (std::size_t i{}; i != n; ++i) {
+                batch.push_back(std::move(items.front()));
+                items.pop_front();
+            }
+            update_size();
+            if (n) {
+                steals.store(steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                stolen.store(stolen.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+        std::size_t size() const {
+            return _size.load(std::memory_order_relaxed);
+        }
+
+        counters stats() const {
+            counters ans;
+            ans.locks = locks.load(std::memory_order_relaxed);
+            ans.contended = contended.load(std::memory_order_relaxed);
+            ans.steals = steals.load(std::memory_order_relaxed);
+            ans.stolen = stolen.load(std::memory_order_relaxed);
+            return ans;
+        }
+    };
+
+    // first task a worker whose deque holds backlog items should try
+    inline task first_task(std::size_t backlog) {
+        return backlog ? task::compute : task::parse;
+    }
+
+    inline task other(task t) {
+        return t == task::parse ? task::compute : task::parse;
+    }
+
+    // steal from the deques of the others, in the given order,
+    // as many items as taken from the first one not empty
+    template <typename T>
+    std::size_t steal_many(const std::vector<deque<T>*>& victims, std::vector<std::unique_ptr<T>>& batch) {
+        for (auto* victim : victims) {
+            if (const auto n = victim->steal_many(batch)) {
+                return n;
+            }
+        }
+        return 0;
+    }
+}
+
+
+#endif
@@ -8,11 +8,21 @@
 #include "numeric_parser.hh"
 // to analyze results
 #include "numeric_consumer.hh"
+// pairs of columns to analyze
+#include "column_pairs.hh"
+// to balance parsing and computing
+#include "work_stealing.hh"
+#ifdef MMAP
+// to read its own share of the input
+#include "mmap_reader.hh"
+// to parse it directly
+#include "fused_parser.hh"
+#endif
 
 
 #include <valarray>
 #include <thread>
-#include <random>
+#include <exception>
 
 // type of data output
 template <typename T, template<typename> typename _numeric_consumer = numeric_consumer>
@@ -26,56 +36,204 @@ public:
 private:
     const std::size_t column_count;
     std::shared_ptr<queues<T>> data_queues;
+    // index of this worker, 0 for the one of the main thread
+    const std::size_t id;
+    // NUMA node this worker runs on (see queues::set_numa_nodes())
+    const std::size_t node;
+    // CPUs it runs on, any if empty (see queues::cpus_of())
+    const std::vector<unsigned> cpus;
+
+    // chunks parsed by this worker and not yet analysed
+    work_stealing::deque<chunk<T>>* const own_deque;
+    // deques of the other workers, by stealing order
+    const std::vector<work_stealing::deque<chunk<T>>*> victims;
+    // chunk completed by the parsers, moved to own_deque
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>> parsed{1};
+    // next chunk the analyser will take before any other queue
+    lockfree_queue::fixed_size_lockfree_queue<chunk<T>> next{1};
+    // chunks stolen together, moved to own_deque
+    std::vector<std::unique_ptr<chunk<T>>> stolen;
 
     // classes effectively performing computations
     numeric_parser<T> parser;
+#ifdef MMAP
+    // used instead of parser in fused mode
+    fused_parser<T> fused;
+#endif
     _numeric_consumer<T> analyser;
 
     // to prevent logi errors
     bool parse_guard{};
     bool compute_guard{};
 
-#ifdef YIELD
-#pragma message "Yield processor if thread 'stalls'..."
     // did nothing during the last iteration?
     bool stalled{};
+    // spin, yield or park when stalled (see queues::wait_options)
+    waiting::waiter waiter;
+
+#ifdef MMAP
+    // byte range of the input to be read by this worker, if any
+    std::unique_ptr<mmap_reader> input;
+    // input completely read?
+    bool input_guard{};
 #endif
 
     // to handle worker in separate thread
     std::thread worker_thread;
+    // error occurred in worker_thread, rethrown by join()
+    std::exception_ptr failure;
 
-    // to grant a minimal amount of randomness in the project
-    // i.e. prevent all threads to continuosly try to use the
-    // same resources concurrently
-    std::unique_ptr<std::random_device> dev; // only one device for all workers
-    std::minstd_rand0 rng;
-    std::uniform_int_distribution<int> distribution; // distribution in range [1, 6]
+    // tasks performed at most by each iteration, readers
+    // are served in between
+    static constexpr int TASKS_PER_ITERATION = 8;
 
-    int parse_repetitions;
-    int compute_repetitions;
+    // move the chunk just parsed to own_deque or, if full, to the
+    // queue of the node, shared by all its workers
+    void store_parsed() {
+        std::unique_ptr<chunk<T>> cnk;
+        if (parsed.poll(cnk) && !own_deque->push(cnk) && !data_queues->node_chunk_queue(node)->offer(cnk)) {
+            // parsers will wait for the next analysis
+            parsed.offer(cnk);
+        }
+    }
+
+    // give the analyser the last chunk parsed by this worker, or
+    // one stolen from the others if there are no chunks in the
+    // shared queues either
+    bool load_next(bool steal) {
+        std::unique_ptr<chunk<T>> cnk;
+        if (!stolen.empty()) {
+            own_deque->push_many(stolen);
+        }
+        if (own_deque->pop(cnk)) {
+            next.offer(cnk);
+            return true;
+        }
+        // half of the chunks of a victim at once, the oldest
+        // first, the others wait in own_deque
+        if (steal && work_stealing::steal_many(victims, stolen)) {
+            cnk = std::move(stolen.front());
+            stolen.erase(stolen.begin());
+            own_deque->push_many(stolen);
+            next.offer(cnk);
+            return true;
+        }
+        return false;
+    }
 
 public:
     worker(std::size_t column_count, std::shared_ptr<queues<T>> data_queues)
-    : column_count{column_count},
+    : worker(column_pairs(column_count), std::move(data_queues))
+    {}
+
+    // analyze only the given pairs of columns, id is the index
+    // of the worker (0 for the one of the main thread), used to
+    // find its deque and its NUMA node
+    worker(const column_pairs& pairs, std::shared_ptr<queues<T>> data_queues, std::size_t id = 0)
+    : column_count{pairs.cols()},
       data_queues{std::move(data_queues)},
-      parser(column_count, this->data_queues->rowQueue, this->data_queues->chunkQueue),
-      analyser(column_count, this->data_queues->chunkQueue),
-      distribution(1,6)
+      id{id},
+      node{this->data_queues->node_of(id)},
+      cpus{this->data_queues->cpus_of(id)},
+      own_deque{this->data_queues->worker_deque(id)},
+      victims{this->data_queues->victims(id)},
+      parser(column_count, this->data_queues->rowQueue.get(), &parsed),
+#ifdef MMAP
+      fused(column_count, &parsed),
+#endif
+      analyser(pairs, &next),
+      waiter(this->data_queues->wait_options, this->data_queues->activity)
     {
-        if (!dev) {
-            dev = std::unique_ptr<std::random_device>(new std::random_device());
+        // recycle chunks between consumers and parsers
+        auto* const pool = this->data_queues->node_chunk_pool(node);
+        parser.set_chunk_pool(pool);
+#ifdef MMAP
+        fused.set_chunk_pool(pool);
+#endif
+        analyser.set_chunk_pool(pool);
+        // chunks of the node, of the other nodes and of the main thread
+        auto shared = this->data_queues->remote_chunk_queues(node);
+        shared.insert(shared.begin(), this->data_queues->node_chunk_queue(node));
+        analyser.set_remote_queues(shared);
+        // large chunks are shared with the other workers
+        if (this->data_queues->split) {
+            analyser.set_split_board(this->data_queues->split.get());
         }
-        rng = std::minstd_rand0((*dev)());
+        // parsers ask the rows of each chunk, consumers report their times
+        parser.set_tuner(this->data_queues->tuner.get());
+#ifdef MMAP
+        fused.set_tuner(this->data_queues->tuner.get());
+#endif
+        analyser.set_tuner(this->data_queues->tuner.get());
         if (this->data_queues->rows_per_chunk) {
             // specify chunk size different from the defaul
             parser.set_rows_per_chunk(this->data_queues->rows_per_chunk);
+#ifdef MMAP
+            fused.set_rows_per_chunk(this->data_queues->rows_per_chunk);
+#endif
         }
-        // reduce calls to random function
-        this->parse_repetitions = distribution(rng);
-        this->compute_repetitions = 1+distribution.max()-parse_repetitions;
     }
 
-    ~worker() = default;
+    // let the calling thread run only on the CPUs of this worker:
+    // its own one if pinned, otherwise in NUMA mode the ones of its
+    // node; there allocate the data it owns, chunks are then
+    // allocated there by the parsers
+    void move_to_node() {
+        if (cpus.empty()) {
+            return;
+        }
+        topology::bind(cpus);
+        if (!data_queues->nodeChunkQueues.empty()) {
+            analyser.reallocate();
+        }
+    }
+
+    // stop the worker thread, if still running
+    ~worker() {
+        if (worker_thread.joinable()) {
+            data_queues->set_aborted();
+            worker_thread.join();
+        }
+    }
+
+#ifdef MMAP
+    // assign a reader to this worker, it will be used to fill the
+    // row queue before parsing or, in fused mode, parsed directly
+    void set_input(std::unique_ptr<mmap_reader> input) {
+        this->input = std::move(input);
+        if (data_queues->fused) {
+            fused.set_input(this->input.get());
+        }
+    }
+
+    // read input rows until the row queue is full
+    // return true if the input has been completely read
+    bool read() {
+        if (input->consume_many()) {
+            data_queues->set_end_of_input();
+            input_guard = true;
+            input.reset();
+        }
+        return input_guard;
+    }
+#endif
+
+#ifdef MMAP
+    // like parse(), but in fused mode: the worker is done
+    // when its own input has been completely parsed
+    bool parse_fused() {
+        bool ans = fused.parse_chunk();
+        if (!ans && !fused.hold_filled() && fused.input_exhausted()) {
+            // store last chunk, if fails will be retried
+            if (fused.store_partial_chunk()) {
+                // no more parsing
+                data_queues->set_end_of_str2num();
+                parse_guard = true;
+            }
+        }
+        return ans;
+    }
+#endif
 
     // to perform parsing - stop after one chunk is completed
     // or no data are available
@@ -86,19 +244,24 @@ public:
         if (parse_guard) {
             throw std::logic_error("parse_guard!");
         }
+#ifdef MMAP
+        if (data_queues->fused) {
+            return parse_fused();
+        }
+#endif
         // check if reader has stopped (here to prevent data races)
         if (data_queues->test_end_of_input()) {
             // if also pasing fail cyeheck if data have been all consumed
             if (!(ans = parser.parse_chunk())) {
                 // discover why failed: eoi or cannot store chunk?
-                if (parser.hold_filled()) {
-                    // failed because insertion failed
+                if (parser.hold_filled() || parser.hold_rows()) {
+                    // failed because insertion or allocation failed
                     return ans;
                 }
-                if (parser.hold()) {
-                    // chunk partially filled - store it directly
-                    !parser.store_partial_chunk();
-                    // if fails, should be retried
+                if (parser.hold() && !parser.store_partial_chunk()) {
+                    // chunk partially filled could not be stored,
+                    // it will be retried (see hold_filled())
+                    return ans;
                 }
                 if (ans == false) {
                     // no more parsing
@@ -121,58 +284,126 @@ public:
     // return true if analyze() did not stall, otherwise return false
     // (i.e. return the value returned by analyze())
     bool compute() {
-        bool ans;
         if (compute_guard) {
             throw std::logic_error("compute_guard!");
         }
-        // similar to parse(): check why analyze() fails
-        // check for end of data supplied
-        if (data_queues->test_end_of_str2num()) {
-            if (!(ans = analyser.analyze())) {
-                // extraction failed - no more input will be available
-                // mark end of analysis for this worker
-                data_queues->set_end_of_analysis();
-                compute_guard = true;
-                // this method should not be called anymore
-                return ans;
-            }
+        // own chunks first
+        load_next(false);
+        // similar to parse(): check why analyze() fails, end of
+        // data supplied is checked before polling not to miss
+        // the last chunks
+        const bool end_of_str2num = data_queues->test_end_of_str2num();
+        // then the shared queues, then the other workers
+        if (analyser.analyze() || (load_next(true) && analyser.analyze())) {
+            return true;
+        }
+        if (end_of_str2num) {
+            // extraction failed - no more input will be available
+            // mark end of analysis for this worker
+            data_queues->set_end_of_analysis();
+            compute_guard = true;
+            // this method should not be called anymore
+        }
+        return false;
+    }
+
+    // perform a task, if possible, return false if it stalled
+    bool run(work_stealing::task t) {
+        store_parsed();
+        if (t == work_stealing::task::compute) {
+            return !compute_guard && compute();
+        }
+        if (parse_guard) {
+            return false;
         }
-        ans = analyser.analyze(); // analyze chunk
+        const bool ans = parse();
+        store_parsed();
         return ans;
     }
 
-    // try to run repeately parse() and then compute()
+    // perform a task allowed by the role of this worker, the first
+    // one by the chunks waiting in own_deque if any is allowed;
+    // once all the input has been read workers help the other
+    // stage to finish
+    bool run_as(stage_roles::role r) {
+        if (r == stage_roles::role::any) {
+            const auto first = work_stealing::first_task(own_deque->size());
+            return run(first) || run(work_stealing::other(first));
+        }
+        const auto own = r == stage_roles::role::parse ? work_stealing::task::parse : work_stealing::task::compute;
+        if (run(own)) {
+            return true;
+        }
+        // tell the controller why
+        if (r == stage_roles::role::compute) {
+            data_queues->roles->report_chunks_missing();
+        } else if (parser.hold_filled() || parser.hold_rows()) {
+            data_queues->roles->report_chunks_blocked();
+        } else {
+            data_queues->roles->report_rows_missing();
+        }
+        return data_queues->test_end_of_input() && run(work_stealing::other(own));
+    }
+
+    // try to run repeately parse() or compute(), as
+    // allowed by the role of this worker (see run_as()),
     // to process some data.
     // must not be called if compute_guard is true
     // Return false if both cannot
     // be called anymore (guards prevent it), otherwise
     // return true
     bool perform_iteration() {
-        int i{}, j{};
-        // perform some parsing
-        for (; i!=parse_repetitions && !parse_guard && parse(); ++i);
-        // perform some computation
-        for (; j!=compute_repetitions && !compute_guard && compute(); ++j);
-#ifdef YIELD
-        stalled = i==0 && j==0;
+        int tasks{};
+        // some other thread failed
+        if (data_queues->test_aborted()) {
+            return false;
+        }
+#ifdef MMAP
+        // produce rows to be parsed
+        if (input && !input_guard && !data_queues->fused) {
+            read();
+            // rows for the parsers of the other workers
+            data_queues->notify();
+        }
 #endif
+        for (; tasks != TASKS_PER_ITERATION && run_as(data_queues->role_of(id)); ++tasks);
+        stalled = tasks == 0;
+        if (!stalled) {
+            // rows or chunks consumed, chunks produced
+            data_queues->notify();
+        }
         return !(parse_guard && compute_guard);
     }
 
+    // like perform_iteration(), but spin, yield or park the
+    // calling thread if nothing can be done
+    bool wait_and_iterate() {
+        waiter.before();
+        const bool ans = perform_iteration();
+        waiter.after(!ans || !stalled);
+        return ans;
+    }
+
     void spawn_and_run() {
         worker_thread = std::thread([this](){
-            while (this->perform_iteration()) {
-#ifdef YIELD
-                if (stalled) {
-                    std::this_thread::yield();
-                }
-#endif
+            try {
+                this->move_to_node();
+                while (this->wait_and_iterate());
+            } catch (...) {
+                // stop all other workers and report the error on join
+                failure = std::current_exception();
+                data_queues->set_aborted();
             }
         });
     }
 
+    // wait for the worker thread to end, rethrow the exception
+    // that caused it to stop, if any
     void join() {
         worker_thread.join();
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
     }
 
     // to obtain final results
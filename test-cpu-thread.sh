@@ -7,7 +7,7 @@ function usage()
 {
   echo "Do the thing many times, usage:"
   echo ""
-  echo "./s.sh --exedir=dir_with_executables --inputdir=dir_with_input [--outputdir=dir_for_output --numreps=number_of_reps]"
+  echo "./s.sh --exedir=dir_with_executables --inputdir=dir_with_input [--outputdir=dir_for_output --numreps=number_of_reps --exeargs=\"extra args, e.g. --wait spin\"]"
   echo ""
 }
 
@@ -32,6 +32,9 @@ while [ "$1" != "" ]; do
     --numreps)
       REPS=$VALUE
       ;;
+    --exeargs)
+      EXEARGS=$VALUE
+      ;;
     *)
       echo "ERROR: unknown parameter \"$PARAM\""
       usage
@@ -70,7 +73,7 @@ for i in $(seq 1 $REPS); do
   for WORKERS in {0..15}; do
     for input in $(ls $INPUTDIR); do
       for exe in $(ls $EXEDIR); do
-        cmd="time perf stat record -ddd -o ${OUTDIR}/perf-stat-run-${RUN}-${exe}-workers-${WORKERS}-${input}-${i}.out ${EXEDIR}/${exe} --workers $WORKERS ${INPUTDIR}/${input} &> /dev/null"
+        cmd="time perf stat record -ddd -o ${OUTDIR}/perf-stat-run-${RUN}-${exe}-workers-${WORKERS}-${input}-${i}.out ${EXEDIR}/${exe} --workers $WORKERS ${EXEARGS} ${INPUTDIR}/${input} &> /dev/null"
         echo "Executing \"$cmd\" ..."
         eval $cmd
       done
@@ -0,0 +1,106 @@
+/**
+ *  Datasets and reference results shared by the tests of the accumulators
+ */
+
+#ifndef TEST_ACCUMULATOR_FIXTURE
+#define TEST_ACCUMULATOR_FIXTURE
+
+#include "../modules/CPP-math-utils/correlation.hh"
+#include "../src/column_pairs.hh"
+#include "../src/pcc_kernels.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <valarray>
+#include <random>
+#include <cmath>
+
+
+// random (rows x cols) table, column by column
+inline std::vector<std::vector<double>> random_dataset(std::size_t rows, std::size_t cols) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(30,77);
+    std::vector<std::vector<double>> ans(cols);
+    for (auto& column : ans) {
+        for (std::size_t r{}; r != rows; ++r) {
+            column.push_back(distribution(generator));
+        }
+    }
+    return ans;
+}
+
+// compare with the explicit computation of each pair, in the
+// order of column_pairs
+inline void check(const std::vector<std::vector<double>>& dataset, const column_pairs& pairs,
+    const std::valarray<math::statistics::pcc_partial<double>>& results
+) {
+    if (results.size() != pairs.size()) {
+        throw std::logic_error("Bad number of results");
+    }
+    std::size_t k{};
+    const auto check_pair = [&](std::size_t c1, std::size_t c2) {
+        const auto expected = math::statistics::pearson_correlation_coefficient(dataset[c1], dataset[c2]).compute();
+        if (std::abs(results[k++].compute() - expected) > 1e-9) {
+            throw std::logic_error("Wrong result for pair (" + std::to_string(c1) + "," + std::to_string(c2) + ")");
+        }
+    };
+    if (pairs.rectangular()) {
+        for (const auto c1 : pairs.a()) {
+            for (const auto c2 : pairs.b()) {
+                check_pair(c1, c2);
+            }
+        }
+        return;
+    }
+    for (std::size_t c1{}; c1 + 1 < pairs.cols(); ++c1) {
+        for (std::size_t c2{c1+1}; c2 != pairs.cols(); ++c2) {
+            check_pair(c1, c2);
+        }
+    }
+}
+
+
+// random table of rows*cols items in [-1, 1)
+template <typename T>
+std::vector<T> random_table(std::size_t rows, std::size_t cols) {
+    std::default_random_engine generator;
+    std::uniform_real_distribution<T> distribution(-1, 1);
+    std::vector<T> ans(rows*cols);
+    for (auto& v : ans) {
+        v = distribution(generator);
+    }
+    return ans;
+}
+
+// for every set of kernels supported by the CPU, make(kernels)
+// must give the partial results expected (e.g. those of the
+// same accumulator with the scalar kernels)
+template <typename T, typename M>
+void for_each_kernel(const std::valarray<math::statistics::pcc_partial<T>>& expected, M&& make) {
+    std::vector<pcc_kernels::routines<T>> kernels{pcc_kernels::best<T>()};
+#ifdef X86_SIMD
+    kernels.push_back(pcc_kernels::sse2<T>());
+    if (cpu_features::has_avx2() && cpu_features::has_fma()) {
+        kernels.push_back(pcc_kernels::avx2<T>());
+    }
+    if (cpu_features::has_avx512f()) {
+        kernels.push_back(pcc_kernels::avx512<T>());
+    }
+#endif
+    const T tolerance = sizeof(T) == sizeof(float) ? 1e-3 : 1e-10;
+    for (const auto& k : kernels) {
+        const std::valarray<math::statistics::pcc_partial<T>> found = make(k);
+        for (std::size_t i{}; i != expected.size(); ++i) {
+            if (std::abs(found[i].sum_prod - expected[i].sum_prod) > tolerance
+                || std::abs(found[i].sum_1_squared - expected[i].sum_1_squared) > tolerance
+                || std::abs(found[i].sum_1 - expected[i].sum_1) > tolerance
+            ) {
+                throw std::logic_error(std::string("Kernels ") + k.name + " mismatch at pair " + std::to_string(i));
+            }
+        }
+    }
+}
+
+
+#endif
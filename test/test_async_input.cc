@@ -0,0 +1,68 @@
+/**
+ *  Test reading files through async_io streams
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/async_input.hh"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+
+// write a file whose size is not a multiple of the block size
+std::string write_test_file() {
+    const std::string filename = "test_async_input.txt";
+    std::ofstream out(filename, std::ios::binary);
+    for (std::size_t i{}; i != 100003; ++i) {
+        out << i << (i % 7 ? ',' : '\n');
+    }
+    return filename;
+}
+
+// the stream must give the same content of std::ifstream
+void check_content(const std::string& filename, const async_io::options& opt) {
+    std::ifstream expected_file(filename, std::ios::binary);
+    const std::string expected{std::istreambuf_iterator<char>(expected_file), {}};
+    auto in = async_io::open(filename, opt);
+    const std::string found{std::istreambuf_iterator<char>(*in), {}};
+    if (found != expected) {
+        throw std::logic_error("Wrong content read from " + filename);
+    }
+}
+
+
+tester test_pread([](){
+    const auto filename = write_test_file();
+    async_io::options opt;
+    opt.force_pread = true;
+    check_content(filename, opt);
+    opt.direct = true;
+    check_content(filename, opt);
+});
+
+
+tester test_async([](){
+    const auto filename = write_test_file();
+    async_io::options opt;
+    // many small requests in flight
+    opt.block_size = 1;
+    opt.queue_depth = 32;
+    check_content(filename, opt);
+    opt.direct = true;
+    check_content(filename, opt);
+});
+
+
+tester test_async_short_reads([](){
+    const auto filename = write_test_file();
+    async_io::options opt;
+    opt.block_size = 1 << 16;
+    // partial completions, not aligned
+    opt.short_reads = 5000;
+    check_content(filename, opt);
+    opt.direct = true;
+    check_content(filename, opt);
+});
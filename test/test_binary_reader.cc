@@ -0,0 +1,84 @@
+/**
+ *  Test conversion to binary files and results of class binary_reader
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/chunk.hh"
+#include "../src/binary_format.hh"
+#include "../src/binary_reader.hh"
+
+#include <stdexcept>
+#include <string>
+#include <memory>
+
+
+// read the whole file checking that all numbers are progressive
+// and start from 0, as in the CSV file they come from
+template <typename T>
+void check_binary_file(const std::string& filename, bool expected_zero_copy) {
+    // number of rows in the test file, see csv.sh
+    constexpr std::size_t rows = 10;
+    // rows per chunk, the last one is partially filled
+    constexpr std::size_t rows_per_chunk = 4;
+
+    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<T>>>(
+        new lockfree_queue::fixed_size_lockfree_queue<chunk<T>>(rows)
+    );
+
+    binary_reader<T> r(filename, outQueue);
+    r.set_rows_per_chunk(rows_per_chunk);
+
+    if (r.zero_copy() != expected_zero_copy) {
+        throw std::logic_error("Unexpected zero copy reading of " + filename);
+    }
+    if (r.row_count() != rows) {
+        throw std::logic_error("Bad row count in " + filename);
+    }
+    if (!r.consume_many()) {
+        throw std::logic_error("Error in chunk consuming!");
+    }
+
+    std::unique_ptr<chunk<T>> cnk;
+    std::size_t read_rows{};
+    T expected_value{};
+    while (outQueue->poll(cnk)) {
+        read_rows += cnk->rows();
+        if (cnk->cols() != r.column_count() || cnk->rows() > rows_per_chunk) {
+            throw std::logic_error("Bad chunk size!");
+        }
+        for (std::size_t row{}; row != cnk->rows(); ++row) {
+            for (std::size_t col{}; col != cnk->cols(); ++col) {
+                // test also strided access used by consumers
+                const T x = cnk->data()[row*cnk->row_offset() + col*cnk->column_offset()];
+                if (cnk->at(row, col) != expected_value || x != expected_value) {
+                    using namespace std::literals;
+                    throw std::logic_error("Found "s + std::to_string(x) + " instead of " + std::to_string(expected_value));
+                }
+                ++expected_value;
+            }
+        }
+    }
+
+    if (read_rows != rows) {
+        throw std::logic_error("Error while reading outQueue!");
+    }
+}
+
+
+tester test_native_format([](){
+    // file containing inputs, see csv.sh
+    binary_format::convert<double>("test.csv", "test.bin");
+    // same type and layout of chunks: no copy
+    check_binary_file<double>("test.bin", true);
+    // items are converted
+    check_binary_file<float>("test.bin", false);
+});
+
+
+tester test_npy_format([](){
+    binary_format::convert<float>("test.csv", "test.npy");
+    check_binary_file<float>("test.npy", true);
+    check_binary_file<double>("test.npy", false);
+});
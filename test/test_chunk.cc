@@ -64,3 +64,42 @@ tester t1([](){
         }
     }
 });
+
+
+tester test_padding([](){
+    using test_type = double;
+    constexpr std::size_t lanes = aligned_buffer::lanes<test_type>();
+
+    // rows and columns start at a cache line
+    for (const auto layout : {chunk_layout::by_rows, chunk_layout::by_columns}) {
+        chunk<test_type> c(13, 7, layout);
+        const std::size_t stride = layout == chunk_layout::by_rows ? c.row_offset() : c.column_offset();
+        if (!aligned_buffer::aligned(c.data()) || stride % lanes != 0 || stride < 7) {
+            throw std::logic_error("Chunk not aligned");
+        }
+    }
+    // no leading dimension a multiple of 4K
+    if (aligned_buffer::leading_dimension<test_type>(512)*sizeof(test_type) % aligned_buffer::ALIASING == 0) {
+        throw std::logic_error("Leading dimension prone to 4K aliasing");
+    }
+
+    // stale items after the last row are cleared
+    chunk<test_type> c(20, 2, chunk_layout::by_columns);
+    for (std::size_t i{}; i != 40; ++i) {
+        c.push_back(1);
+    }
+    c.clear();
+    for (std::size_t i{}; i != 6; ++i) {
+        c.push_back(2);
+    }
+    if (c.zero_padding() != lanes) {
+        throw std::logic_error("Wrong number of padded rows");
+    }
+    for (std::size_t col{}; col != 2; ++col) {
+        for (std::size_t r{}; r != lanes; ++r) {
+            if (c.get_column(col)[r] != (r < 3 ? 2 : 0)) {
+                throw std::logic_error("Padding not cleared");
+            }
+        }
+    }
+});
@@ -0,0 +1,102 @@
+/**
+ *  Test recycling of chunks through chunk_pool
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/chunk.hh"
+#include "../src/chunk_pool.hh"
+#include "../src/row_block.hh"
+#include "../src/numeric_parser.hh"
+#include "../src/numeric_consumer.hh"
+
+#include <stdexcept>
+#include <string>
+#include <memory>
+
+
+tester test_recycle([](){
+    chunk_pool<double> pool(1);
+    auto c1 = pool.acquire(10, 3);
+    const double* buffer = c1->data();
+    c1->push_back(1);
+    pool.recycle(c1);
+    if (c1) {
+        throw std::logic_error("Recycled chunk not released");
+    }
+    // same buffer, empty again
+    auto c2 = pool.acquire(10, 3);
+    if (c2->data() != buffer || !c2->empty() || pool.allocations() != 1) {
+        throw std::logic_error("Chunk not reused");
+    }
+    // the pool holds a single chunk, views are never kept
+    auto c3 = pool.acquire(10, 3);
+    auto view = std::make_unique<chunk<double>>(c3->data(), 10, 3, 1, 10);
+    pool.recycle(view);
+    pool.recycle(c2);
+    pool.recycle(c3);
+    if (pool.acquire(10, 3)->data() != buffer || pool.acquire(10, 3)->data() == buffer) {
+        throw std::logic_error("Pool bound not respected");
+    }
+    // chunks of a different size are not reused
+    auto c4 = pool.acquire(10, 3);
+    pool.recycle(c4);
+    pool.acquire(5, 3);
+    if (pool.allocations() != 5) {
+        throw std::logic_error("Unexpected allocations");
+    }
+});
+
+
+// chunks go around between a parser and a consumer
+tester test_steady_state([](){
+    constexpr std::size_t cols = 3, rows_per_chunk = 4;
+    chunk_pool<double> pool(4);
+    lockfree_queue::fixed_size_lockfree_queue<row_block> row_queue(1);
+    lockfree_queue::fixed_size_lockfree_queue<chunk<double>> chunk_queue(1);
+    numeric_parser<double> parser(cols, &row_queue, &chunk_queue);
+    parser.set_rows_per_chunk(rows_per_chunk);
+    parser.set_chunk_pool(&pool);
+    numeric_consumer<double> consumer(cols, &chunk_queue);
+    consumer.set_chunk_pool(&pool);
+
+    for (int i{}; i != 100; ++i) {
+        auto block = std::make_unique<row_block>(cols, rows_per_chunk);
+        for (std::size_t r{}; r != rows_per_chunk; ++r) {
+            for (std::size_t c{}; c != cols; ++c) {
+                block->push_field(std::to_string(i + r*c));
+            }
+            block->end_row();
+        }
+        if (!row_queue.offer(block) || !parser.parse_chunk() || !consumer.analyze()) {
+            throw std::logic_error("Chunk not passed on");
+        }
+    }
+    if (pool.allocations() != 1) {
+        throw std::logic_error("Chunks allocated in steady state: " + std::to_string(pool.allocations()));
+    }
+});
+
+
+// chunks are allocated only within the budget, the first one anyway
+tester test_budget([](){
+    const auto bytes = chunk_pool<double>::bytes(10, 3);
+    memory_budget budget(2*bytes);
+    chunk_pool<double> pool(2);
+    pool.set_budget(&budget);
+    auto c1 = pool.acquire(10, 3), c2 = pool.acquire(10, 3), c3 = pool.acquire(10, 3);
+    if (!c1 || !c2 || c3 || budget.bytes() != 2*bytes || !budget.pressure()) {
+        throw std::logic_error("Budget not respected");
+    }
+    // with allocations waiting, chunks are freed instead of kept
+    pool.recycle(c1);
+    if (budget.bytes() != bytes || !(c3 = pool.acquire(10, 3))) {
+        throw std::logic_error("Bytes not given back");
+    }
+    // a single chunk larger than the budget is allowed
+    memory_budget small(1);
+    if (!small.try_acquire(bytes) || small.try_acquire(1) || small.peak() != bytes) {
+        throw std::logic_error("First allocation refused");
+    }
+});
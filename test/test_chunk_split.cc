@@ -0,0 +1,194 @@
+/**
+ *  Test chunks whose pairs are split among consumers
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/chunk.hh"
+#include "../src/chunk_split.hh"
+#include "../src/chunk_tuning.hh"
+#include "../src/column_pairs.hh"
+#include "../src/numeric_consumer.hh"
+#include "../src/triangular_accumulator.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <cmath>
+
+
+// the closed form gives the pairs in the order of the results
+tester test_pair_at([](){
+    for (const std::size_t cols : {2, 3, 10, 1001}) {
+        std::size_t p{};
+        for (std::size_t c1{}; c1 + 1 < cols; ++c1) {
+            for (std::size_t c2{c1+1}; c2 != cols; ++c2, ++p) {
+                const auto pair = column_pairs::pair_at(cols, p);
+                if (pair.first != c1 || pair.second != c2) {
+                    throw std::logic_error("Wrong pair " + std::to_string(p) + " of " + std::to_string(cols) + " columns");
+                }
+            }
+        }
+    }
+});
+
+
+// tiles are taken once, the last one completed releases the chunk
+tester test_shared_chunk([](){
+    if (chunk_split::tiles_for(100, 10, 8) != 1 || chunk_split::tiles_for(50000000, 256, 8) != 8) {
+        throw std::logic_error("Wrong number of tiles");
+    }
+    auto cnk = std::make_unique<chunk<double>>(4, 3);
+    chunk_split::shared_chunk<double> shared(std::move(cnk), chunk_layout::by_columns, 3);
+    if (shared.get().layout() != chunk_layout::by_columns) {
+        throw std::logic_error("Layout not converted");
+    }
+    std::size_t a, b, c, d;
+    if (!shared.take(a) || !shared.take(b) || !shared.take(c) || shared.take(d) || !shared.exhausted()) {
+        throw std::logic_error("Wrong tiles taken");
+    }
+    if (shared.complete() || shared.complete() || !shared.complete() || !shared.release()) {
+        throw std::logic_error("Chunk not released");
+    }
+    chunk_split::board<double> board(3);
+    if (board.find()) {
+        throw std::logic_error("Chunk found on empty board");
+    }
+    board.publish(std::make_shared<chunk_split::shared_chunk<double>>(std::make_unique<chunk<double>>(4, 3), chunk_layout::by_rows, 1));
+    const auto found = board.find();
+    if (!found || !found->take(a) || board.find()) {
+        throw std::logic_error("Exhausted chunk not removed");
+    }
+});
+
+
+// tiles of the triangle added by separate accumulators
+// give the results of a single one
+tester test_tiles([](){
+    constexpr std::size_t rows = 300, cols = 45, tiles = 4;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(30, 77);
+    std::vector<double> table(rows*cols);
+    for (auto& v : table) {
+        v = distribution(generator);
+    }
+    triangular_pcc_accumulator<double> whole(cols);
+    whole.accumulate(table.data(), rows, cols, cols, 1);
+    auto expected = whole.to_pcc_partial_valarray();
+
+    std::valarray<math::statistics::pcc_partial<double>> found(expected.size());
+    std::size_t covered{};
+    for (std::size_t t{}; t != tiles; ++t) {
+        triangular_pcc_accumulator<double> part(cols);
+        const auto rows_of_tile = part.tile_rows(t, tiles);
+        if (rows_of_tile.first != covered) {
+            throw std::logic_error("Tiles not contiguous");
+        }
+        covered = rows_of_tile.second;
+        part.accumulate_rows(table.data(), rows, cols, 1, rows_of_tile.first, rows_of_tile.second, t == 0);
+        found += part.to_pcc_partial_valarray();
+    }
+    if (covered != cols) {
+        throw std::logic_error("Tiles do not cover the triangle");
+    }
+    for (std::size_t k{}; k != expected.size(); ++k) {
+        if (std::abs(found[k].compute() - expected[k].compute()) > 1e-9) {
+            throw std::logic_error("Wrong result for pair " + std::to_string(k));
+        }
+    }
+});
+
+
+// a consumer shares a large chunk, consumers without
+// chunks of their own help with the tiles of shared ones
+#if !defined(SLOW) && !defined(BLACKHOLE)
+tester test_consumers([](){
+    constexpr std::size_t rows = 2048, cols = 160;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(30, 77);
+    lockfree_queue::fixed_size_lockfree_queue<chunk<double>> queue(1), empty(1);
+    auto cnk = std::make_unique<chunk<double>>(rows, cols);
+    std::vector<double> table;
+    for (std::size_t i{}; i != rows*cols; ++i) {
+        table.push_back(distribution(generator));
+        cnk->push_back(table.back());
+    }
+    if (!queue.offer(cnk)) {
+        throw std::logic_error("Cannot insert chunk");
+    }
+    chunk_split::board<double> board(4);
+    numeric_consumer<double> owner(cols, &queue), helper(cols, &empty);
+    owner.set_split_board(&board);
+    helper.set_split_board(&board);
+    if (chunk_split::tiles_for(cols*(cols-1)/2, rows, 4) < 2) {
+        throw std::logic_error("Chunk not large enough to be split");
+    }
+    // the owner takes all the tiles, nobody is left to help
+    if (!owner.analyze() || helper.analyze() || owner.analyze()) {
+        throw std::logic_error("Bad number of chunks analyzed");
+    }
+    // a chunk shared while the others are analysing
+    cnk = std::make_unique<chunk<double>>(rows, cols);
+    for (const auto v : table) {
+        cnk->push_back(v);
+    }
+    board.publish(std::make_shared<chunk_split::shared_chunk<double>>(std::move(cnk), chunk_layout::by_rows, 2));
+    if (!helper.analyze() || !owner.analyze() || helper.analyze()) {
+        throw std::logic_error("Shared tiles not analyzed");
+    }
+    triangular_pcc_accumulator<double> whole(cols);
+    whole.accumulate(table.data(), rows, cols, cols, 1);
+    whole.accumulate(table.data(), rows, cols, cols, 1);
+    const auto expected = whole.to_pcc_partial_valarray();
+    std::valarray<math::statistics::pcc_partial<double>> found = owner.get_results_and_invalidate();
+    found += helper.get_results_and_invalidate();
+    for (std::size_t k{}; k != expected.size(); ++k) {
+        if (std::abs(found[k].compute() - expected[k].compute()) > 1e-9) {
+            throw std::logic_error("Wrong result for pair " + std::to_string(k));
+        }
+    }
+});
+
+
+// split chunks are reported to the tuner by the consumer completing
+// their last tile: slow chunks while starving make rows shrink
+tester test_split_tuning([](){
+    constexpr std::size_t rows = 256, cols = 1000;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(30, 77);
+    std::vector<double> table(rows*cols);
+    for (auto& v : table) {
+        v = distribution(generator);
+    }
+    if (chunk_split::tiles_for(cols*(cols-1)/2, rows, 4) < 2) {
+        throw std::logic_error("Chunk not large enough to be split");
+    }
+    lockfree_queue::fixed_size_lockfree_queue<chunk<double>> queue(1);
+    chunk_split::board<double> board(4);
+    chunk_tuning::tuner tuner(rows);
+    numeric_consumer<double> consumer(cols, &queue);
+    consumer.set_split_board(&board);
+    consumer.set_tuner(&tuner);
+    // starving: the queue is found empty
+    for (std::size_t i{}; i != 100; ++i) {
+        if (consumer.analyze()) {
+            throw std::logic_error("Chunk analysed from an empty queue");
+        }
+    }
+    for (std::size_t i{}; i != 64; ++i) {
+        auto cnk = std::make_unique<chunk<double>>(rows, cols);
+        for (const auto v : table) {
+            cnk->push_back(v);
+        }
+        if (!queue.offer(cnk) || !consumer.analyze()) {
+            throw std::logic_error("Chunk not analysed");
+        }
+    }
+    if (!tuner.changes() || tuner.rows() >= rows) {
+        throw std::logic_error("Split chunks not reported to the tuner");
+    }
+});
+#endif
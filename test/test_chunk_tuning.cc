@@ -0,0 +1,65 @@
+/**
+ *  Test choice and adaptation of the rows of chunks
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/chunk_tuning.hh"
+#include "../src/topology.hh"
+
+#include <stdexcept>
+#include <string>
+
+
+tester test_rows_for([](){
+    if (topology::parse_size("48K") != 48 << 10 || topology::parse_size("2M") != 2 << 20 || topology::parse_size("x") != 0) {
+        throw std::logic_error("Wrong cache size");
+    }
+    topology::cache_sizes caches;
+    caches.l2 = 1 << 20;
+    // narrow files get large chunks, bounded, wide files a
+    // block of rows of the accumulator of all the pairs
+    const auto narrow = chunk_tuning::rows_for<double>(3, caches);
+    const auto wide = chunk_tuning::rows_for<double>(4000, caches);
+    if (narrow <= 1000 || narrow > chunk_tuning::MAX_ROWS || wide != triangular_pcc_accumulator<double>::BLOCK_ROWS) {
+        throw std::logic_error("Unexpected rows: " + std::to_string(narrow) + ", " + std::to_string(wide));
+    }
+    // chunks stay in the budget, a multiple of the cache lines
+    const auto rows = chunk_tuning::rows_for<double>(30, caches);
+    if (rows % aligned_buffer::lanes<double>() != 0 || rows*aligned_buffer::leading_dimension<double>(30)*sizeof(double) > caches.l2/2) {
+        throw std::logic_error("Chunks larger than the budget");
+    }
+    // the machine caches are read anyway
+    if (topology::caches().l2 == 0) {
+        throw std::logic_error("No L2 size");
+    }
+});
+
+
+tester test_tuner([](){
+    chunk_tuning::tuner tuner(64);
+    // cheap chunks: rows grow, up to 8 times
+    for (int i{}; i != 10000; ++i) {
+        tuner.chunk_analysed(tuner.rows(), 1000);
+    }
+    if (tuner.rows() != 512) {
+        throw std::logic_error("Rows not grown: " + std::to_string(tuner.rows()));
+    }
+    // expensive chunks and idle consumers: rows shrink
+    for (int i{}; i != 10000; ++i) {
+        tuner.queue_empty();
+        tuner.queue_empty();
+        tuner.chunk_analysed(tuner.rows(), 10000000);
+    }
+    if (tuner.rows() != 8) {
+        throw std::logic_error("Rows not shrunk: " + std::to_string(tuner.rows()));
+    }
+    // chunks of old sizes are not considered
+    const auto changes = tuner.changes();
+    for (int i{}; i != 10000; ++i) {
+        tuner.chunk_analysed(7, 1000);
+    }
+    if (tuner.changes() != changes) {
+        throw std::logic_error("Old chunks considered");
+    }
+});
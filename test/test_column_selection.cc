@@ -0,0 +1,95 @@
+/**
+ *  Test column selection and the projection performed by readers
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/row_block.hh"
+#include "../src/column_selection.hh"
+#include "../src/mmap_reader.hh"
+#include "../src/reader.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+
+
+tester test_parse_columns([](){
+    const std::vector<std::string> names{"a", "b", "c", "d", "e", "f", "g"};
+    // names, indexes and ranges in any order, duplicates ignored
+    const auto s = parse_columns("f, 1-2,a,5-", names.size(), names);
+    const std::vector<std::size_t> expected{0, 1, 2, 5, 6};
+    if (s.size() != expected.size() || s.total() != names.size()) {
+        throw std::logic_error("Bad selection size");
+    }
+    for (std::size_t i{}; i != expected.size(); ++i) {
+        if (s.column(i) != expected[i] || !s.selected(expected[i])) {
+            throw std::logic_error("Bad selected column");
+        }
+    }
+    if (s.selected(3) || s.contiguous() || !parse_columns("2-", 5).contiguous()) {
+        throw std::logic_error("Bad selection");
+    }
+    for (const auto spec : {"h", "3-9", "4-2", "1,", "-1"}) {
+        bool thrown = false;
+        try {
+            parse_columns(spec, names.size(), names);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw std::logic_error(std::string("Invalid selection accepted: ") + spec);
+        }
+    }
+});
+
+
+// blocks must contain only the selected columns of test.csv
+template <typename R>
+void check_projection(R& r, lockfree_queue::fixed_size_lockfree_queue<row_block>& queue) {
+    // see csv.sh: 10 rows of 3 columns, values are progressive
+    constexpr std::size_t rows = 10, cols = 3;
+    const auto names = read_header("test.csv");
+    if (names.size() != cols || names[2] != "col3") {
+        throw std::logic_error("Bad header");
+    }
+    r.select_columns(parse_columns("col1,2", cols, names));
+    if (r.column_count() != 2) {
+        throw std::logic_error("Bad column count");
+    }
+    if (!r.consume_many()) {
+        throw std::logic_error("Error in row consuming!");
+    }
+
+    std::unique_ptr<row_block> block;
+    std::size_t read_rows{};
+    while (queue.poll(block)) {
+        for (std::size_t row{}; row != block->rows(); ++row, ++read_rows) {
+            if (block->cols() != 2
+                || block->field(row, 0) != std::to_string(read_rows*cols)
+                || block->field(row, 1) != std::to_string(read_rows*cols + 2)
+            ) {
+                throw std::logic_error("Bad projected row");
+            }
+        }
+    }
+    if (read_rows != rows) {
+        throw std::logic_error("Bad row count");
+    }
+}
+
+
+tester test_mmap_projection([](){
+    lockfree_queue::fixed_size_lockfree_queue<row_block> queue(10);
+    mmap_reader r("test.csv", &queue);
+    check_projection(r, queue);
+});
+
+
+tester test_reader_projection([](){
+    lockfree_queue::fixed_size_lockfree_queue<row_block> queue(10);
+    reader r("test.csv", &queue);
+    check_projection(r, queue);
+});
@@ -0,0 +1,71 @@
+/**
+ *  Test pools of parsers and analysers and their controller
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/stage_roles.hh"
+#include "../src/controller.hh"
+
+#include <stdexcept>
+#include <memory>
+
+
+// the pool starving downstream gets a worker
+tester test_needed([](){
+    using stage_roles::role;
+    stage_roles::sample s;
+    if (stage_roles::needed(s) != role::any) {
+        throw std::logic_error("Move without reason");
+    }
+    s.chunks_missing = 3;
+    if (stage_roles::needed(s) != role::parse) {
+        throw std::logic_error("Analysers starving, no parser added");
+    }
+    s.rows_missing = 1;
+    if (stage_roles::needed(s) != role::any) {
+        throw std::logic_error("Both pools idle, worker moved");
+    }
+    s = {};
+    s.chunks_blocked = 1;
+    if (stage_roles::needed(s) != role::compute) {
+        throw std::logic_error("Parsers blocked, no analyser added");
+    }
+});
+
+
+// pools never remain empty, the main worker has no role
+tester test_assignment([](){
+    using stage_roles::role;
+    stage_roles::assignment roles(5, 2);
+    if (roles.of(0) != role::any || roles.count(role::parse) != 2 || roles.count(role::compute) != 2) {
+        throw std::logic_error("Wrong initial roles");
+    }
+    for (int i{}; i != 5; ++i) {
+        roles.move(role::parse, role::compute);
+    }
+    if (roles.count(role::parse) != 1 || roles.count(role::compute) != 3 || roles.of(0) != role::any) {
+        throw std::logic_error("Pool left empty");
+    }
+});
+
+
+// the controller moves workers as reported by them
+tester test_rebalance([](){
+    using stage_roles::role;
+    auto q = std::make_shared<queues<double>>(5);
+    q->set_stage_roles();
+    controller<double> c(q);
+    q->roles->report_chunks_blocked();
+    c.rebalance();
+    if (c.moves() != 1 || q->roles->count(role::compute) != 3) {
+        throw std::logic_error("No analyser added");
+    }
+    // nothing reported in the last period
+    c.rebalance();
+    q->roles->report_chunks_missing();
+    c.rebalance();
+    if (c.moves() != 2 || q->roles->count(role::parse) != 2) {
+        throw std::logic_error("No parser added");
+    }
+});
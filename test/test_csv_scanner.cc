@@ -0,0 +1,90 @@
+/**
+ *  Test the vectorized CSV scanner
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/csv_scanner.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+
+
+/**
+ * @brief every classification routine must give the same
+ * results of the scalar one
+ *
+ * @return tester
+ */
+tester test_classifiers([](){
+    constexpr std::size_t tests = 1000;
+    const std::string alphabet = "0123456789.,\"\n\r -";
+
+    std::default_random_engine generator;
+    std::uniform_int_distribution<std::size_t> distribution(0, alphabet.size()-1);
+
+    std::vector<csv_scanner::classifier> classifiers{csv_scanner::best_classifier()};
+#ifdef X86_SIMD
+    classifiers.push_back(csv_scanner::classify_sse2);
+    if (cpu_features::has_avx2()) {
+        classifiers.push_back(csv_scanner::classify_avx2);
+    }
+#endif
+
+    char window[csv_scanner::WINDOW];
+    for (std::size_t t{}; t != tests; ++t) {
+        for (auto& c : window) {
+            c = alphabet[distribution(generator)];
+        }
+        const auto expected = csv_scanner::classify_scalar(window);
+        for (auto classify : classifiers) {
+            const auto found = classify(window);
+            if (found.quotes != expected.quotes || found.separators != expected.separators) {
+                throw std::logic_error("Classification mismatch");
+            }
+        }
+    }
+});
+
+
+/**
+ * @brief separators inside quoted fields must be ignored, also
+ * when quoted fields cross the boundary between two windows
+ *
+ * @return tester
+ */
+tester test_quoted_separators([](){
+    // build a line longer than a window, with quoted fields
+    // containing separators
+    std::string input;
+    std::vector<std::size_t> expected;
+    for (int i{}; i != 40; ++i) {
+        input += i % 3 ? "\"1,\n2\"" : "12";
+        expected.push_back(input.size());
+        input += i % 7 ? ',' : '\n';
+    }
+    input += "\"3\"";
+
+    csv_scanner scanner(input.data(), input.data() + input.size());
+    const char* p = input.data();
+    for (auto pos : expected) {
+        const char* sep = scanner.next(p);
+        if (sep != input.data() + pos) {
+            using namespace std::literals;
+            throw std::logic_error("Separator expected at "s + std::to_string(pos) + ", found at "s + std::to_string(sep - input.data()));
+        }
+        p = sep + 1;
+    }
+    if (scanner.next(p) != input.data() + input.size() || scanner.unterminated()) {
+        throw std::logic_error("Bad end of input");
+    }
+
+    // input ending inside a quoted field
+    const std::string bad = "1,\"2\n";
+    csv_scanner bad_scanner(bad.data(), bad.data() + bad.size());
+    if (bad_scanner.next(bad.data() + 2) != bad.data() + bad.size() || !bad_scanner.unterminated()) {
+        throw std::logic_error("Unterminated quoted field not detected");
+    }
+});
@@ -0,0 +1,101 @@
+/**
+ *  Test the decompression stage
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/decompressor.hh"
+
+#include <stdexcept>
+#include <string>
+#include <memory>
+
+
+// produce the sequence 0, 1, 2, ... (modulo 256) in pieces of
+// irregular size, as a decompressor would do
+class counting_source : public compression::source {
+    std::size_t produced{};
+    const std::size_t total;
+    const bool fail;
+
+public:
+    counting_source(std::size_t total, bool fail = false)
+    : total{total}, fail{fail}
+    {}
+
+    std::size_t read(char* out, std::size_t size) override {
+        if (produced == total) {
+            if (fail) {
+                throw std::runtime_error("Corrupted input");
+            }
+            return 0;
+        }
+        const auto n = std::min({size, total - produced, 1 + produced % 100003});
+        for (std::size_t i{}; i != n; ++i) {
+            out[i] = static_cast<char>(produced++);
+        }
+        return n;
+    }
+};
+
+
+/**
+ * @brief all data produced by the source must be read in order,
+ * also when it spans many blocks
+ *
+ * @return tester
+ */
+tester test_blocks([](){
+    const std::size_t total = 5*compression::decompressing_streambuf::BLOCK_BYTES + 12345;
+    compression::decompressing_istream in(std::make_unique<counting_source>(total));
+
+    std::size_t read{};
+    char c;
+    while (in.get(c)) {
+        if (c != static_cast<char>(read)) {
+            throw std::logic_error("Wrong byte in position " + std::to_string(read));
+        }
+        ++read;
+    }
+    if (read != total) {
+        throw std::logic_error("Read " + std::to_string(read) + " bytes instead of " + std::to_string(total));
+    }
+});
+
+
+/**
+ * @brief errors occurred while decompressing must be reported
+ * to the reader, after the data produced before them
+ *
+ * @return tester
+ */
+tester test_failure([](){
+    const std::size_t total = 3*compression::decompressing_streambuf::BLOCK_BYTES;
+    compression::decompressing_istream in(std::make_unique<counting_source>(total, true));
+
+    std::size_t read{};
+    bool thrown = false;
+    try {
+        char c;
+        while (in.get(c)) {
+            ++read;
+        }
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    if (!thrown || read != total) {
+        throw std::logic_error("Decompression error not reported correctly");
+    }
+});
+
+
+/**
+ * @brief a reader may stop before the end of the input
+ *
+ * @return tester
+ */
+tester test_early_stop([](){
+    compression::decompressing_istream in(std::make_unique<counting_source>(100*compression::decompressing_streambuf::BLOCK_BYTES));
+    char c;
+    in.get(c);
+});
@@ -0,0 +1,72 @@
+/**
+ *  Test direct conversion from mapped file to chunks
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/chunk.hh"
+#include "../src/mmap_reader.hh"
+#include "../src/fused_parser.hh"
+
+#include <stdexcept>
+#include <string>
+#include <memory>
+
+
+tester test_fused_parser([](){
+    using test_type = int;
+    // file containing inputs, see csv.sh
+    const std::string test_file = "test.csv";
+    // rows and columns in the test file
+    constexpr std::size_t rows = 10;
+    constexpr std::size_t cols = 3;
+    // rows per chunk, the last chunk will be partially filled
+    constexpr std::size_t rows_per_chunk = 4;
+    constexpr std::size_t chunks = (rows + rows_per_chunk - 1) / rows_per_chunk;
+
+    //  OUTPUT queue with the resulting chunks
+    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<test_type>>>(
+        new lockfree_queue::fixed_size_lockfree_queue<chunk<test_type>>(chunks)
+    );
+
+    // row queue is not used
+    mmap_reader r(test_file, nullptr);
+    if (r.column_count() != cols) {
+        throw std::logic_error("Bad column count");
+    }
+    auto ranges = r.split(1);
+
+    fused_parser<test_type> fp(cols, outQueue);
+    fp.set_rows_per_chunk(rows_per_chunk);
+    fp.set_input(ranges[0].get());
+
+    // parse all input
+    fp.parse_many();
+    if (!fp.input_exhausted()) {
+        throw std::logic_error("Input should be exhausted");
+    }
+    if (!fp.store_partial_chunk()) {
+        throw std::logic_error("Failed insertion of last chunk");
+    }
+    if (outQueue->size() != chunks) {
+        throw std::logic_error("Bad size of outQueue");
+    }
+
+    // values are progressive and start from 0
+    test_type expected_value{};
+    std::unique_ptr<chunk<test_type>> cnk;
+    while (outQueue->poll(cnk)) {
+        for (std::size_t row{}; row != cnk->rows(); ++row) {
+            for (std::size_t col{}; col != cols; ++col) {
+                if (cnk->at(row, col) != expected_value++) {
+                    using namespace std::literals;
+                    throw std::logic_error("Inequality found at ("s + std::to_string(row) + ","s + std::to_string(col) + ")"s);
+                }
+            }
+        }
+    }
+    if (expected_value != rows*cols) {
+        throw std::logic_error("Some rows are missing");
+    }
+});
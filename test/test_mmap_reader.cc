@@ -0,0 +1,125 @@
+/**
+ *  Test results of class mmap_reader
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+
+#include "../src/row_block.hh"
+#include "../src/mmap_reader.hh"
+#include "../src/numeric_parser.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+
+
+tester test_mmap_reader([](){
+    // file containing inputs, see csv.sh
+    const std::string test_file = "test.csv";
+    // number of rows in the test file, all of them
+    // are expected to fit in a single block
+    constexpr std::size_t rows = 10;
+    // forst value in the dataset: 0
+    constexpr int initial_value{};
+
+    // generate queue:
+    //  OUTPUT queue with blocks to convert
+    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>>(
+        new lockfree_queue::fixed_size_lockfree_queue<row_block>(1)
+    );
+
+    // define reader
+    mmap_reader r(test_file, outQueue);
+
+    // read all input
+    if (!r.consume_many()) {
+        // input file is dimensioned to get true from consume_many()
+        throw std::logic_error("Error in row consuming!");
+    }
+
+    // outQueue size should be coherent
+    if (!outQueue->full()) {
+        throw std::logic_error("outQueue should be full!");
+    }
+
+    // test that all output number are progressive and start from 0
+    std::unique_ptr<row_block> block;
+    std::size_t read_rows{};
+    int expected_value{initial_value};
+    while (outQueue->poll(block)) {
+        // repeat untill new blocks can be extracted
+        read_rows += block->rows();
+
+        if (block->cols() != r.column_count()) {
+            throw std::logic_error("Bad row size!");
+        }
+        // test block content, quotes must have been removed
+        for (std::size_t row{}; row != block->rows(); ++row) {
+            for (std::size_t col{}; col != block->cols(); ++col) {
+                const auto x = block->field(row, col);
+                if (field_to_number<int>(x) != expected_value) {
+                    using namespace std::literals;
+                    throw std::logic_error("Found "s + std::string(x) + " instead of " + std::to_string(expected_value));
+                }
+                ++expected_value;
+            }
+        }
+    }
+
+    if (read_rows != rows) {
+        // mess!
+        throw std::logic_error("Error while reading outQueue!");
+    }
+});
+
+
+tester test_mmap_reader_split([](){
+    // file containing inputs, see csv.sh
+    const std::string test_file = "test.csv";
+    // rows and columns in the test file
+    constexpr std::size_t rows = 10;
+    constexpr std::size_t cols = 3;
+    // how many readers will share the input
+    constexpr std::size_t readers = 4;
+
+    // at most one block per reader
+    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>>(
+        new lockfree_queue::fixed_size_lockfree_queue<row_block>(readers)
+    );
+
+    mmap_reader r(test_file, outQueue);
+    auto others = r.split(readers);
+    if (others.size() != readers) {
+        throw std::logic_error("Bad number of readers after split!");
+    }
+
+    // every reader consume its own range
+    for (auto& o : others) {
+        if (!o->consume_many()) {
+            throw std::logic_error("Error in row consuming!");
+        }
+    }
+
+    // all rows must be found exactly once, in any order
+    std::vector<int> found(rows*cols);
+    std::unique_ptr<row_block> block;
+    std::size_t read_rows{};
+    while (outQueue->poll(block)) {
+        read_rows += block->rows();
+        for (std::size_t row{}; row != block->rows(); ++row) {
+            for (std::size_t col{}; col != block->cols(); ++col) {
+                const auto x = block->field(row, col);
+                auto v = field_to_number<int>(x);
+                if (v < 0 || std::size_t(v) >= found.size() || found[v]++) {
+                    using namespace std::literals;
+                    throw std::logic_error("Unexpected value "s + std::string(x));
+                }
+            }
+        }
+    }
+    if (read_rows != rows) {
+        throw std::logic_error("Some rows were lost or duplicated!");
+    }
+});
@@ -0,0 +1,116 @@
+/**
+ *  Test the number parsing backends
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/number_parsing.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+
+template <typename T>
+T parse_fast(const std::string& str) {
+    return number_parsing::fast::parse<T>(str.data(), str.data() + str.size());
+}
+
+template <typename T>
+T parse_from_chars(const std::string& str) {
+    return number_parsing::from_chars::parse<T>(str.data(), str.data() + str.size());
+}
+
+/**
+ * @brief the digits fast path must give the same results
+ * of from_chars, also for floating point types
+ *
+ * @return tester
+ */
+tester test_digits_fast_path([](){
+    std::default_random_engine generator;
+    std::uniform_int_distribution<long long> distribution(-(1ll << 62), 1ll << 62);
+
+    std::vector<std::string> fields{"0", "-0", "7", "-7", "16777217", "9007199254740993", "1234567890123456789"};
+    for (std::size_t t{}; t != 10000; ++t) {
+        fields.push_back(std::to_string(distribution(generator) >> (t % 62)));
+    }
+    for (const auto& f : fields) {
+        if (parse_fast<double>(f) != parse_from_chars<double>(f)) {
+            throw std::logic_error("Wrong double conversion of " + f);
+        }
+        if (parse_fast<float>(f) != parse_from_chars<float>(f)) {
+            throw std::logic_error("Wrong float conversion of " + f);
+        }
+        if (f.size() < 9 && parse_fast<int>(f) != std::stoi(f)) {
+            throw std::logic_error("Wrong int conversion of " + f);
+        }
+    }
+});
+
+/**
+ * @brief fields which are not made only of digits must be
+ * converted as from_chars does (also by the decimal fast path),
+ * malformed ones must be refused
+ *
+ * @return tester
+ */
+tester test_fallback([](){
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-1e6, 1e6);
+
+    std::vector<std::string> fields{
+        "0.5", "-1e10", "3.4028235e38", "1e-30", "12345678901234567890123",
+        "0.1", "16777217.0", "1.00000005960464477539", "9007199254740993.5", ".5", "5."
+    };
+    char buffer[64];
+    for (std::size_t t{}; t != 100000; ++t) {
+        const char* formats[] = {"%.17g", "%.6f", "%.3f", "%.12f"};
+        std::snprintf(buffer, sizeof(buffer), formats[t % 4], distribution(generator));
+        fields.push_back(buffer);
+    }
+    for (const auto& f : fields) {
+        if (parse_fast<double>(f) != parse_from_chars<double>(f)) {
+            throw std::logic_error("Wrong double conversion of " + f);
+        }
+        if (parse_fast<float>(f) != parse_from_chars<float>(f)) {
+            throw std::logic_error("Wrong float conversion of " + f);
+        }
+    }
+
+    for (std::string f : {"", "-", "1.5x", "abc", "1 2"}) {
+        bool thrown = false;
+        try {
+            parse_fast<double>(f);
+        } catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        if (!thrown) {
+            throw std::logic_error("Malformed field \"" + f + "\" accepted");
+        }
+    }
+    // too big for an int
+    bool thrown = false;
+    try {
+        parse_fast<int>("12345678901");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    if (!thrown) {
+        throw std::logic_error("Overflowing int accepted");
+    }
+});
+
+/**
+ * @brief surrounding blanks and leading '+' are ignored
+ *
+ * @return tester
+ */
+tester test_field_to_number([](){
+    if (field_to_number<double>("  +2.5\t") != 2.5 || field_to_number<int>(" -42 ") != -42) {
+        throw std::logic_error("Blanks or sign not handled");
+    }
+});
+
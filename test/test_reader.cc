@@ -8,6 +8,7 @@
 
 #include "../src/chunk.hh"
 #include "../src/reader.hh"
+#include "../src/row_block.hh"
 
 #include <stdexcept>
 #include <string>
@@ -17,21 +18,23 @@
 #include <valarray>
 #include <iostream>
 #include <algorithm>
+#include <fstream>
+#include <cstdio>
 
 
 tester test_reader([](){
     // file containing inputs
     const std::string test_file = "test.csv";
-    // size of the queue containing the rows produced
-    // by the reader, set to the size of the test file
+    // number of rows in the test file, all of them
+    // are expected to fit in a single block
     constexpr std::size_t rows = 10;
     // forst value in the dataset: 0
     constexpr int initial_value{};
 
     // generate queue:
-    //  OUTPUT queue with strings to read
-    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>>(
-        new lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>(rows)
+    //  OUTPUT queue with blocks of strings to read
+    auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>>(
+        new lockfree_queue::fixed_size_lockfree_queue<row_block>(1)
     );
 
     // define reader
@@ -49,28 +52,71 @@ tester test_reader([](){
     }
 
     // test that all output number are progressive and start from 0
-    std::unique_ptr<std::vector<std::string>> row;
+    std::unique_ptr<row_block> block;
     std::size_t read_rows{};
     int expected_value{initial_value};
-    while (outQueue->poll(row)) {
-        // repeat untill new rows can be extracted
-        ++read_rows;
+    while (outQueue->poll(block)) {
+        // repeat untill new blocks can be extracted
+        read_rows += block->rows();
 
-        // rest row content
-        for (const auto& x : *row) {
-            if (math::convertions::ston<decltype(expected_value)>(x) != expected_value) {
-                using namespace std::literals;
-                throw std::logic_error("Found "s + x + " instead of " + std::to_string(expected_value));
+        // test block content
+        for (std::size_t row{}; row != block->rows(); ++row) {
+            for (std::size_t col{}; col != block->cols(); ++col) {
+                const std::string x(block->field(row, col));
+                if (math::convertions::ston<decltype(expected_value)>(x) != expected_value) {
+                    using namespace std::literals;
+                    throw std::logic_error("Found "s + x + " instead of " + std::to_string(expected_value));
+                }
+                ++expected_value;
             }
-            ++expected_value;
         }
-
-        // free data
-        row.release();
     }
 
-    if (read_rows != outQueue->capacity()) {
+    if (read_rows != rows) {
         // mess!
         throw std::logic_error("Error while reading outQueue!");
     }
 });
+
+
+// rows spanning many reads, quoted fields and CRLF terminators,
+// the text of each block is tokenized in place
+tester test_reader_pieces([](){
+    const std::string test_file = "test_pieces.csv";
+    constexpr std::size_t rows = 20000, cols = 7;
+    {
+        std::ofstream out(test_file, std::ios::binary);
+        out << "\xEF\xBB\xBF" << "a,\"b\",c,d,e,f,g\r\n";
+        for (std::size_t r{}; r != rows; ++r) {
+            for (std::size_t c{}; c != cols; ++c) {
+                const auto v = std::to_string(r*cols + c);
+                out << (c ? "," : "") << (c % 2 ? '"' + v + '"' : v);
+            }
+            out << (r % 3 ? "\n" : "\r\n\n");
+        }
+    }
+    if (rows*cols*6 < 4*reader::READ_SIZE) {
+        throw std::logic_error("Test file too small");
+    }
+    lockfree_queue::fixed_size_lockfree_queue<row_block> queue(rows);
+    reader r(test_file, &queue);
+    if (r.column_count() != cols || !r.consume_many()) {
+        throw std::logic_error("Error in row consuming!");
+    }
+    std::unique_ptr<row_block> block;
+    std::size_t read_rows{}, blocks{};
+    while (queue.poll(block)) {
+        ++blocks;
+        for (std::size_t row{}; row != block->rows(); ++row, ++read_rows) {
+            for (std::size_t col{}; col != cols; ++col) {
+                if (block->field(row, col) != std::to_string(read_rows*cols + col)) {
+                    throw std::logic_error("Found " + std::string(block->field(row, col)) + " at row " + std::to_string(read_rows));
+                }
+            }
+        }
+    }
+    std::remove(test_file.c_str());
+    if (read_rows != rows || blocks < 2) {
+        throw std::logic_error("Error while reading the queue!");
+    }
+});
@@ -0,0 +1,101 @@
+/**
+ *  Test correlation of the pairs of a rectangle
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
+#include "accumulator_fixture.hh"
+
+#include "../src/chunk.hh"
+#include "../src/column_pairs.hh"
+#include "../src/numeric_consumer.hh"
+#include "../src/rectangular_accumulator.hh"
+#include "../src/aligned_buffer.hh"
+
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+
+tester test_layouts([](){
+    constexpr std::size_t rows = 257, cols = 11;
+    const auto dataset = random_dataset(rows, cols);
+    // a column may be on both sides, a has a remainder of 4
+    const column_pairs pairs(cols, {0, 2, 3, 5, 7, 8, 10}, {1, 3, 9});
+
+    // by columns and by rows, in two pieces of different size
+    for (const bool by_columns : {true, false}) {
+        std::vector<double> table(rows*cols);
+        const std::size_t row_offset = by_columns ? 1 : cols;
+        const std::size_t column_offset = by_columns ? rows : 1;
+        for (std::size_t r{}; r != rows; ++r) {
+            for (std::size_t c{}; c != cols; ++c) {
+                table[r*row_offset + c*column_offset] = dataset[c][r];
+            }
+        }
+        rectangular_pcc_accumulator<double> accumulator(pairs.a(), pairs.b());
+        constexpr std::size_t first = 100;
+        accumulator.accumulate(table.data(), first, cols, row_offset, column_offset);
+        accumulator.accumulate(table.data() + first*row_offset, rows - first, cols, row_offset, column_offset);
+        check(dataset, pairs, accumulator.to_pcc_partial_valarray());
+    }
+});
+
+
+tester test_consumer([](){
+    constexpr std::size_t rows = 100, cols = 6;
+    const auto dataset = random_dataset(rows, cols);
+    const column_pairs pairs(cols, {4}, {0, 1, 2, 3, 5});
+
+    lockfree_queue::fixed_size_lockfree_queue<chunk<double>> queue(1);
+    auto cnk = std::make_unique<chunk<double>>(rows, cols);
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            cnk->push_back(dataset[c][r]);
+        }
+    }
+    if (!queue.offer(cnk)) {
+        throw std::logic_error("Cannot insert chunk");
+    }
+    numeric_consumer<double> consumer(pairs, &queue);
+    if (!consumer.analyze() || consumer.analyze()) {
+        throw std::logic_error("Bad number of chunks analyzed");
+    }
+    check(dataset, pairs, consumer.get_results_and_invalidate());
+});
+
+
+// every set of kernels supported by the CPU gives the results of
+// the scalar one, with rows not multiple of the registers, and with
+// columns aligned and padded with zeros (see chunk::zero_padding())
+template <typename T>
+void check_kernels() {
+    constexpr std::size_t rows = 203, cols = 13;
+    const auto table = random_table<T>(rows, cols);
+    const std::size_t ld = aligned_buffer::leading_dimension<T>(rows);
+    const std::size_t padded_rows = (rows + aligned_buffer::lanes<T>() - 1) / aligned_buffer::lanes<T>() * aligned_buffer::lanes<T>();
+    const auto aligned = aligned_buffer::allocate<T>(ld*cols);
+    for (std::size_t c{}; c != cols; ++c) {
+        std::copy(table.begin() + c*rows, table.begin() + (c+1)*rows, aligned.get() + c*ld);
+    }
+    const column_pairs pairs(cols, {0, 1, 2, 4, 5, 6, 8, 11, 12}, {1, 3, 7, 9, 10});
+    rectangular_pcc_accumulator<T> expected(pairs.a(), pairs.b(), pcc_kernels::scalar<T>());
+    expected.accumulate(table.data(), rows, cols, 1, rows);
+    const auto e = expected.to_pcc_partial_valarray();
+    for_each_kernel<T>(e, [&](const pcc_kernels::routines<T>& k){
+        rectangular_pcc_accumulator<T> accumulator(pairs.a(), pairs.b(), k);
+        accumulator.accumulate(table.data(), rows, cols, 1, rows);
+        return accumulator.to_pcc_partial_valarray();
+    });
+    for_each_kernel<T>(e, [&](const pcc_kernels::routines<T>& k){
+        rectangular_pcc_accumulator<T> accumulator(pairs.a(), pairs.b(), k);
+        accumulator.accumulate(aligned.get(), rows, cols, 1, ld, padded_rows);
+        return accumulator.to_pcc_partial_valarray();
+    });
+}
+
+tester test_kernels([](){
+    check_kernels<double>();
+    check_kernels<float>();
+});
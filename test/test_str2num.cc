@@ -6,6 +6,7 @@
 #include "../modules/CPP-lockfree-queue/fixed_size_lockfree_queue.hh"
 
 #include "../src/chunk.hh"
+#include "../src/row_block.hh"
 #include "../src/numeric_parser.hh"
 
 #include <stdexcept>
@@ -29,9 +30,9 @@ tester test_conversion_int([](){
     test_type generator{};
 
     // generate queues:
-    //  INPUT queue with strings to read
-    auto inQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>>(
-        new lockfree_queue::fixed_size_lockfree_queue<std::vector<std::string>>(rows)
+    //  INPUT queue with blocks of strings to read
+    auto inQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<row_block>>(
+        new lockfree_queue::fixed_size_lockfree_queue<row_block>(rows)
     );
     //  OUTPUT queue with the resulting chunk
     auto outQueue = std::shared_ptr<lockfree_queue::fixed_size_lockfree_queue<chunk<test_type>>>(
@@ -44,16 +45,16 @@ tester test_conversion_int([](){
     // numeric parser to be tested
     numeric_parser<test_type> np(cols, inQueue, outQueue);
 
-    // fill INPUT QUEUE
+    // fill INPUT QUEUE, one row per block
     for (std::size_t r{}; r!=rows; ++r) {
         // line to parse
-        std::vector<std::string> vs;
+        auto offered = std::make_unique<row_block>(cols, 1);
         for (std::size_t c{}; c!=cols; ++c) {
-            vs.push_back(std::to_string(generator));
+            offered->push_field(std::to_string(generator));
             test_mat[r][c] = generator++;
         }
-        // store vector
-        auto offered = std::make_unique<decltype(vs)>(std::move(vs));
+        offered->end_row();
+        // store block
         if (!inQueue->offer(offered)) {
             throw std::logic_error("Failed insertion in inQueue");
         }
@@ -0,0 +1,88 @@
+/**
+ *  Test NUMA topology and per node chunk queues
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/topology.hh"
+#include "../src/queues.hh"
+#include "../src/numeric_consumer.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+
+
+tester test_cpu_list([](){
+    const std::vector<unsigned> expected{0, 1, 2, 3, 8, 10, 11};
+    if (topology::parse_cpu_list("0-3,8,10-11\n") != expected) {
+        throw std::logic_error("Wrong CPU list");
+    }
+    if (!topology::parse_cpu_list("").empty()) {
+        throw std::logic_error("CPUs in empty list");
+    }
+    // the machine has at least a node with a CPU
+    const auto nodes = topology::nodes();
+    if (nodes.empty() || nodes.front().cpus.empty()) {
+        throw std::logic_error("No NUMA node found");
+    }
+});
+
+
+// a consumer steals chunks of other nodes only when its own queue is empty
+tester test_node_queues([](){
+    constexpr std::size_t cols = 3;
+    queues<double> q(4);
+    const auto node = topology::nodes().front();
+    q.set_numa_nodes({node, node});
+    if (q.node_of(3) != 1 || q.node_chunk_queue(0) == q.node_chunk_queue(1) || q.node_chunk_pool(0) == q.node_chunk_pool(1)) {
+        throw std::logic_error("Nodes not separated");
+    }
+    const auto remote = q.remote_chunk_queues(0);
+    if (remote.size() != 2 || remote[0] != q.node_chunk_queue(1) || remote[1] != q.chunkQueue.get()) {
+        throw std::logic_error("Wrong remote queues");
+    }
+
+    numeric_consumer<double> consumer(cols, q.node_chunk_queue(0));
+    consumer.set_remote_queues(remote);
+    consumer.reallocate();
+    for (auto* queue : {q.node_chunk_queue(0), q.node_chunk_queue(1), q.chunkQueue.get()}) {
+        auto cnk = std::make_unique<chunk<double>>(2, cols);
+        for (std::size_t i{}; i != 2*cols; ++i) {
+            cnk->push_back(i);
+        }
+        if (!queue->offer(cnk)) {
+            throw std::logic_error("Cannot insert chunk");
+        }
+    }
+    std::unique_ptr<chunk<double>> other;
+    if (!consumer.analyze() || !q.node_chunk_queue(1)->poll(other)) {
+        throw std::logic_error("Chunk of another node stolen first");
+    }
+    if (!consumer.analyze() || consumer.analyze()) {
+        throw std::logic_error("Bad number of chunks analyzed");
+    }
+});
+
+
+// threads share cores only when needed, or fill them one by one
+tester test_placement([](){
+    // two cores with two CPUs each, siblings numbered apart
+    const std::vector<topology::cpu> cpus{{0, 0, 0}, {1, 1, 0}, {2, 0, 0}, {3, 1, 0}};
+    const std::vector<unsigned> avoid{0, 1, 2, 3}, pack{0, 2, 1, 3};
+    if (topology::placement_order(cpus, topology::smt::avoid) != avoid || topology::placement_order(cpus, topology::smt::pack) != pack) {
+        throw std::logic_error("Wrong placement order");
+    }
+    const auto others = topology::without_core_of(cpus, 2);
+    if (others.size() != 2 || others[0].id != 1 || others[1].id != 3) {
+        throw std::logic_error("Core not isolated");
+    }
+    // the main thread alone on CPU 0, the others share the rest
+    queues<double> q(4);
+    q.pin_workers({0, 1, 3}, true);
+    const std::vector<unsigned> expected{0, 1, 3, 1};
+    if (q.worker_cpus != expected || q.cpus_of(2) != std::vector<unsigned>{3}) {
+        throw std::logic_error("Wrong worker CPUs");
+    }
+});
@@ -0,0 +1,85 @@
+/**
+ *  Test conversion of chunks between layouts
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/chunk.hh"
+#include "../src/transpose.hh"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <memory>
+
+
+// every routine available for T must transpose tables of any size,
+// also when they are not multiple of tiles and blocks
+template <typename T>
+void check_routines() {
+    std::vector<transpose::routine<T>> routines{transpose::naive<T>, transpose::scalar<T>, transpose::best_routine<T>()};
+    for (const auto routine : routines) {
+        for (const std::size_t rows : {1, 7, 8, 33, 64, 101}) {
+            for (const std::size_t cols : {1, 4, 9, 32, 70}) {
+                // leading dimensions larger than the table
+                const std::size_t lda = cols + 3, ldb = rows + 5;
+                std::vector<T> a(rows*lda), b(cols*ldb, -1);
+                for (std::size_t i{}; i != a.size(); ++i) {
+                    a[i] = T(i);
+                }
+                routine(a.data(), lda, b.data(), ldb, rows, cols);
+                for (std::size_t i{}; i != rows; ++i) {
+                    for (std::size_t j{}; j != cols; ++j) {
+                        if (b[j*ldb + i] != a[i*lda + j]) {
+                            throw std::logic_error("Wrong transposition of " + std::to_string(rows) + "x" + std::to_string(cols));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+tester test_routines([](){
+    check_routines<double>();
+    check_routines<float>();
+    check_routines<int>();
+});
+
+
+tester test_assign([](){
+    constexpr std::size_t rows = 50, cols = 13;
+    chunk<double> by_rows(rows, cols);
+    for (std::size_t i{}; i != rows*cols; ++i) {
+        by_rows.push_back(i);
+    }
+    std::unique_ptr<chunk<double>> scratch;
+    // same layout: no copy
+    if (&with_layout(by_rows, chunk_layout::by_rows, scratch) != &by_rows || scratch) {
+        throw std::logic_error("Chunk copied needlessly");
+    }
+    auto& by_columns = with_layout(by_rows, chunk_layout::by_columns, scratch);
+    // and back, partially filled
+    chunk<double> partial(rows, cols, chunk_layout::by_columns);
+    for (std::size_t i{}; i != 3*cols; ++i) {
+        partial.push_back(i);
+    }
+    chunk<double> back(rows, cols);
+    back.assign(partial);
+    if (!by_columns.stored_by_columns() || by_columns.rows() != rows || back.rows() != 3 || !back.stored_by_rows()) {
+        throw std::logic_error("Bad layout or size");
+    }
+    for (std::size_t r{}; r != rows; ++r) {
+        for (std::size_t c{}; c != cols; ++c) {
+            if (by_columns.at(r, c) != by_rows.at(r, c) || (r < 3 && back.at(r, c) != by_rows.at(r, c))) {
+                throw std::logic_error("Wrong item after transposition");
+            }
+        }
+    }
+    // insertion goes on after the rows assigned
+    back.push_back(-1);
+    if (back.at(3, 0) != -1) {
+        throw std::logic_error("Wrong insertion after assign");
+    }
+});
@@ -0,0 +1,59 @@
+/**
+ *  Test the blocked correlation of all the pairs
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+#include "accumulator_fixture.hh"
+
+#include "../src/column_pairs.hh"
+#include "../src/triangular_accumulator.hh"
+
+#include <vector>
+
+
+// more than a block of rows, columns not multiple of the register
+// blocks, a tiny L2 to have many blocks of columns
+tester test_blocks([](){
+    constexpr std::size_t rows = 600;
+    for (const std::size_t cols : {1, 2, 5, 37, 70}) {
+        const auto dataset = random_dataset(rows, cols);
+        for (const bool by_columns : {false, true}) {
+            std::vector<double> table(rows*cols);
+            const std::size_t row_offset = by_columns ? 1 : cols;
+            const std::size_t column_offset = by_columns ? rows : 1;
+            for (std::size_t r{}; r != rows; ++r) {
+                for (std::size_t c{}; c != cols; ++c) {
+                    table[r*row_offset + c*column_offset] = dataset[c][r];
+                }
+            }
+            for (const std::size_t l2 : {std::size_t(1) << 10, std::size_t(1) << 20}) {
+                triangular_pcc_accumulator<double> accumulator(cols, l2);
+                constexpr std::size_t first = 300;
+                accumulator.accumulate(table.data(), first, cols, row_offset, column_offset);
+                accumulator.accumulate(table.data() + first*row_offset, rows - first, cols, row_offset, column_offset);
+                check(dataset, column_pairs(cols), accumulator.to_pcc_partial_valarray());
+            }
+        }
+    }
+});
+
+
+// every set of kernels supported by the CPU gives the
+// results of the scalar one, for both types
+template <typename T>
+void check_kernels() {
+    constexpr std::size_t rows = 300, cols = 75;
+    const auto table = random_table<T>(rows, cols);
+    triangular_pcc_accumulator<T> expected(cols, 1 << 12, pcc_kernels::scalar<T>());
+    expected.accumulate(table.data(), rows, cols, cols, 1);
+    for_each_kernel<T>(expected.to_pcc_partial_valarray(), [&](const pcc_kernels::routines<T>& k){
+        triangular_pcc_accumulator<T> accumulator(cols, 1 << 12, k);
+        accumulator.accumulate(table.data(), rows, cols, cols, 1);
+        return accumulator.to_pcc_partial_valarray();
+    });
+}
+
+tester test_kernels([](){
+    check_kernels<double>();
+    check_kernels<float>();
+});
@@ -0,0 +1,76 @@
+/**
+ *  Test parking and waking of idle threads
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/wait_strategy.hh"
+
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+
+// a parked thread is woken by a notification, long before its timeout
+tester test_notify([](){
+    waiting::eventcount events;
+    std::atomic_bool ready{};
+    const auto start = std::chrono::steady_clock::now();
+    std::thread t([&](){
+        while (!ready.load()) {
+            const auto key = events.prepare_wait();
+            if (ready.load()) {
+                events.cancel_wait();
+                break;
+            }
+            events.wait(key, std::chrono::seconds(10));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ready.store(true);
+    events.notify_all();
+    t.join();
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5)) {
+        throw std::logic_error("Parked thread not woken");
+    }
+});
+
+
+// without notifications, parking lasts at most the timeout
+tester test_timeout([](){
+    waiting::eventcount events;
+    const auto key = events.prepare_wait();
+    const auto start = std::chrono::steady_clock::now();
+    events.wait(key, std::chrono::milliseconds(1));
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5)) {
+        throw std::logic_error("Timeout not respected");
+    }
+});
+
+
+// threads park only after their spins and yields
+tester test_waiter([](){
+    waiting::eventcount events;
+    waiting::options opts;
+    opts.policy = waiting::strategy::park;
+    opts.spins = 3;
+    opts.yields = 2;
+    waiting::waiter w(opts, events);
+    for (int i{}; i != 5; ++i) {
+        if (w.parking()) {
+            throw std::logic_error("Parking too early");
+        }
+        w.before();
+        w.after(false);
+    }
+    if (!w.parking()) {
+        throw std::logic_error("Not parking");
+    }
+    // progress resets the budgets
+    w.before();
+    w.after(true);
+    if (w.parking()) {
+        throw std::logic_error("Budgets not reset");
+    }
+});
@@ -0,0 +1,64 @@
+/**
+ *  Test deques of workers and stealing order
+ */
+
+#include "../modules/CPP-test-unit/tester.hh"
+
+#include "../src/work_stealing.hh"
+#include "../src/queues.hh"
+
+#include <stdexcept>
+#include <memory>
+
+
+// owner takes the last item pushed, thieves the first half
+tester test_deque([](){
+    work_stealing::deque<int> d(3);
+    auto a = std::make_unique<int>(1), b = std::make_unique<int>(2), c = std::make_unique<int>(3), e = std::make_unique<int>(4);
+    if (!d.push(a) || !d.push(b) || !d.push(c) || d.push(e) || !e || d.size() != 3) {
+        throw std::logic_error("Capacity not respected");
+    }
+    std::vector<std::unique_ptr<int>> batch;
+    if (d.steal_many(batch) != 2 || *batch[0] != 1 || *batch[1] != 2) {
+        throw std::logic_error("Wrong items stolen");
+    }
+    std::unique_ptr<int> item;
+    if (!d.pop(item) || *item != 3) {
+        throw std::logic_error("Wrong item popped");
+    }
+    if (d.pop(item) || d.steal_many(batch) || d.size() != 0) {
+        throw std::logic_error("Items from empty deque");
+    }
+    // items stolen go back in a single step, as far as they fit
+    batch.push_back(std::move(e));
+    if (d.push_many(batch) != 3 || !batch.empty() || d.size() != 3) {
+        throw std::logic_error("Batch not pushed");
+    }
+    const auto stats = d.stats();
+    if (stats.steals != 1 || stats.stolen != 2 || stats.locks < 5 || stats.contended != 0) {
+        throw std::logic_error("Wrong counters");
+    }
+});
+
+
+// workers parse only when they have no chunk waiting
+tester test_first_task([](){
+    if (work_stealing::first_task(0) != work_stealing::task::parse || work_stealing::first_task(3) != work_stealing::task::compute) {
+        throw std::logic_error("Wrong priority");
+    }
+    if (work_stealing::other(work_stealing::task::parse) != work_stealing::task::compute) {
+        throw std::logic_error("Wrong other task");
+    }
+});
+
+
+// workers steal first from the workers of their node
+tester test_victims([](){
+    queues<double> q(4);
+    const auto node = topology::nodes().front();
+    q.set_numa_nodes({node, node});
+    const auto victims = q.victims(0);
+    if (victims.size() != 3 || victims[0] != q.worker_deque(2) || victims[1] != q.worker_deque(1) || victims[2] != q.worker_deque(3)) {
+        throw std::logic_error("Wrong stealing order");
+    }
+});